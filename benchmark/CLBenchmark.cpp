@@ -0,0 +1,206 @@
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "CLGemm.h"
+#include "CLBenchmarkCommon.h"
+
+// GEMM benchmark: sweeps the matrix sizes, element types and kernel variants, and reports every phase separately
+//  (device selection, program build, upload, kernel, readback) next to the multithreaded host backend
+//  (CLHostGemm), which is also the reference of the result check.
+//  The result is written as CSV or JSON, so that runs (i.e. on a CPU-only runtime such as PoCL) can be compared.
+//
+//  usage: CLBenchmark [--list] [--platform N] [--device N] [--sizes 256,512,1024] [--types int,float,double]
+//      [--variants naive,naive_transposed,tiled,tiled_vector] [--repeats N] [--threads N]
+//      [--format csv|json] [--output path] [--no-reference]
+
+#define MAX_VAL 100
+#define MIN_VAL 1
+
+struct GemmBenchmarkOptions : BenchmarkOptions
+{
+    std::vector<std::string> types = { "int", "float", "double" };
+    std::vector<std::string> variants = { "naive", "naive_transposed", "tiled", "tiled_vector" };
+    size_t threads = 0;     // 0: std::thread::hardware_concurrency()
+    bool is_reference = true;
+
+    GemmBenchmarkOptions()
+    {
+        sizes = { 256, 512, 1024 };
+    }
+};
+
+static bool parseOptions(int argc, char* argv[], GemmBenchmarkOptions& options)
+{
+    return parseBenchmarkOptions(argc, argv, options, [&options](const std::string& arg, const std::string& value)
+    {
+        if ( arg == "--no-reference" )
+        {
+            options.is_reference = false;
+        }
+        else if ( arg == "--types" )
+        {
+            options.types = splitList(value);
+        }
+        else if ( arg == "--variants" )
+        {
+            options.variants = splitList(value);
+        }
+        else if ( arg == "--threads" )
+        {
+            options.threads = std::stoul(value);
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }, { "--no-reference" });
+}
+
+static bool parseVariant(const std::string& name, CLGemm::Variant& variant)
+{
+    CLGemm::Variant variants[] = { CLGemm::Variant::Naive, CLGemm::Variant::NaiveTransposed,
+        CLGemm::Variant::Tiled, CLGemm::Variant::TiledVector };
+    for ( CLGemm::Variant v : variants )
+    {
+        if ( CLGemm::getVariantName(v) == name )
+        {
+            variant = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+static double getGflops(size_t size, double ms)
+{
+    return ms > 0 ? 2.0 * size * size * size / (ms * 1e6) : 0;
+}
+
+// times of the report are in ms and averaged over the repeats: select_ms is CLSession::create(), including the
+//  platform / device enumeration, build_ms the program build of the element type, kernel_ms includes the transpose
+//  of naive_transposed, wall_ms is the host time of CLGemm::multiply() and host_ms the one of CLHostGemm.
+template<typename T>
+void benchmarkType(CLGemm& gemm, const GemmBenchmarkOptions& options, const std::string& device, const std::string& type,
+    double select_ms, double build_ms, std::vector<BenchmarkRow>& rows)
+{
+    CLHostGemm host_gemm(options.threads);
+    double tolerance = (type == "int") ? 0.0 : 1e-4;
+
+    for ( size_t size : options.sizes )
+    {
+        std::vector<T> matrixA(size * size);
+        std::vector<T> matrixB(size * size);
+        std::vector<T> matrixResult(size * size);
+        std::vector<T> matrixReference(size * size);
+        for ( T& value : matrixA )
+        {
+            value = (T)((rand() % (MAX_VAL - MIN_VAL)) + MIN_VAL);
+        }
+        for ( T& value : matrixB )
+        {
+            value = (T)((rand() % (MAX_VAL - MIN_VAL)) + MIN_VAL);
+        }
+
+        double host_ms = 0;
+        if ( options.is_reference )
+        {
+            auto start = std::chrono::steady_clock::now();
+            host_gemm.multiply(matrixA.data(), matrixB.data(), matrixReference.data(), size, size, size);
+            host_ms = getElapsedMs(start);
+        }
+
+        for ( const std::string& variant_name : options.variants )
+        {
+            CLGemm::Variant variant;
+            if ( !parseVariant(variant_name, variant) )
+            {
+                std::cerr << "Unknown variant " << variant_name << ", skipped\n";
+                continue;
+            }
+
+            BenchmarkTiming timing = measureBenchmark(gemm.getWrapper(type), options.repeats, [&]()
+            {
+                gemm.multiply(matrixA.data(), matrixB.data(), matrixResult.data(), size, size, size, variant);
+                return true;
+            });
+            std::string check = !options.is_reference ? "skipped" :
+                CLGemm::verify(matrixReference.data(), matrixResult.data(), matrixResult.size(), tolerance) ? "pass" : "fail";
+
+            BenchmarkRow row;
+            row.add("device", device).add("type", type).add("variant", variant_name).add("size", size)
+                .add("select_ms", select_ms).add("build_ms", build_ms)
+                .add("upload_ms", timing.upload_ms).add("kernel_ms", timing.kernel_ms)
+                .add("readback_ms", timing.readback_ms).add("wall_ms", timing.wall_ms)
+                .add("kernel_gflops", getGflops(size, timing.kernel_ms))
+                .add("host_ms", host_ms).add("host_gflops", getGflops(size, host_ms)).add("check", check);
+            rows.push_back(row);
+
+            std::cerr << type << " " << size << " " << variant_name << ": kernel " << timing.kernel_ms
+                << " ms, wall " << timing.wall_ms << " ms, host " << host_ms << " ms, " << check << '\n';
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    GemmBenchmarkOptions options;
+    if ( !parseOptions(argc, argv, options) )
+    {
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<CLSession> session = CLSession::create(options.platformId, options.deviceId, CL_QUEUE_PROFILING_ENABLE);
+    double select_ms = getElapsedMs(start);
+    if ( !session->isValid() )
+    {
+        return 1;
+    }
+
+    std::string device = CLSession::getDeviceName(session->getDevice());
+    std::cerr << "Device: " << device << '\n';
+
+    std::string extensions = CLSession::getDeviceInfoString(session->getDevice(), CL_DEVICE_EXTENSIONS);
+    bool is_fp64 = extensions.find("cl_khr_fp64") != std::string::npos;
+
+    std::vector<BenchmarkRow> rows;
+    for ( const std::string& type : options.types )
+    {
+        if ( type == "double" && !is_fp64 )
+        {
+            std::cerr << "double: skipped, cl_khr_fp64 not supported by the device\n";
+            continue;
+        }
+        if ( type != "int" && type != "float" && type != "double" )
+        {
+            std::cerr << "Unknown type " << type << ", skipped\n";
+            continue;
+        }
+
+        // a fresh CLGemm per type, the first getWrapper() builds the program
+        CLGemm gemm(session);
+        gemm.enableProfiling();
+        start = std::chrono::steady_clock::now();
+        gemm.getWrapper(type);
+        double build_ms = getElapsedMs(start);
+
+        if ( type == "int" )
+        {
+            benchmarkType<int>(gemm, options, device, type, select_ms, build_ms, rows);
+        }
+        else if ( type == "float" )
+        {
+            benchmarkType<float>(gemm, options, device, type, select_ms, build_ms, rows);
+        }
+        else
+        {
+            benchmarkType<double>(gemm, options, device, type, select_ms, build_ms, rows);
+        }
+    }
+
+    return writeBenchmarkReport(options, rows);
+}
@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "CLBenchmarkCommon.h"
+
+bool parseBenchmarkOptions(int argc, char* argv[], BenchmarkOptions& options,
+    const std::function<bool(const std::string& arg, const std::string& value)>& parse_option,
+    const std::vector<std::string>& flags)
+{
+    for ( int i = 1; i < argc; i++ )
+    {
+        std::string arg = argv[i];
+        if ( arg == "--list" )
+        {
+            CLSession::listDevices();
+            std::exit(0);
+        }
+        if ( std::find(flags.begin(), flags.end(), arg) != flags.end() )
+        {
+            if ( !parse_option(arg, "") )
+            {
+                std::cerr << "Unknown option " << arg << '\n';
+                return false;
+            }
+            continue;
+        }
+
+        if ( i + 1 >= argc )
+        {
+            std::cerr << "Missing value for " << arg << '\n';
+            return false;
+        }
+        std::string value = argv[++i];
+
+        if ( arg == "--platform" )
+        {
+            options.platformId = std::stoi(value);
+        }
+        else if ( arg == "--device" )
+        {
+            options.deviceId = std::stoi(value);
+        }
+        else if ( arg == "--sizes" )
+        {
+            options.sizes.clear();
+            for ( const std::string& size : splitList(value) )
+            {
+                options.sizes.push_back(std::stoul(size));
+            }
+        }
+        else if ( arg == "--repeats" )
+        {
+            options.repeats = std::max<size_t>(1, std::stoul(value));
+        }
+        else if ( arg == "--format" )
+        {
+            options.format = value;
+        }
+        else if ( arg == "--output" )
+        {
+            options.output = value;
+        }
+        else if ( !parse_option(arg, value) )
+        {
+            std::cerr << "Unknown option " << arg << '\n';
+            return false;
+        }
+    }
+
+    if ( options.format != "csv" && options.format != "json" )
+    {
+        std::cerr << "Unknown format " << options.format << ", expected csv or json\n";
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::string> splitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::istringstream iss(list);
+    std::string item;
+    while ( std::getline(iss, item, ',') )
+    {
+        if ( !item.empty() )
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+double getElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+double getCategoryTime(const std::vector<CLProfileStats>& stats, const std::string& category, size_t repeats)
+{
+    double total_ms = 0;
+    for ( const CLProfileStats& stat : stats )
+    {
+        if ( stat.category == category )
+        {
+            total_ms += stat.total_ms;
+        }
+    }
+    return total_ms / repeats;
+}
+
+BenchmarkTiming measureBenchmark(CLSimpleWrapper& wrapper, size_t repeats, const std::function<bool()>& run)
+{
+    BenchmarkTiming timing = BenchmarkTiming();
+    timing.is_pass = run();
+    wrapper.resetProfiling();
+
+    auto start = std::chrono::steady_clock::now();
+    for ( size_t repeat = 0; repeat < repeats; repeat++ )
+    {
+        timing.is_pass = run() && timing.is_pass;
+    }
+    timing.wall_ms = getElapsedMs(start) / repeats;
+
+    std::vector<CLProfileStats> stats = wrapper.getProfilingStats();
+    timing.upload_ms = getCategoryTime(stats, "write", repeats);
+    timing.kernel_ms = getCategoryTime(stats, "kernel", repeats);
+    timing.readback_ms = getCategoryTime(stats, "read", repeats);
+    return timing;
+}
+
+BenchmarkRow& BenchmarkRow::add(const std::string& name, const std::string& value)
+{
+    m_fields.push_back(Field{ name, value, true });
+    return *this;
+}
+
+BenchmarkRow& BenchmarkRow::add(const std::string& name, const char* value)
+{
+    return add(name, std::string(value));
+}
+
+std::string BenchmarkRow::get(const std::string& name) const
+{
+    for ( const Field& field : m_fields )
+    {
+        if ( field.name == name )
+        {
+            return field.value;
+        }
+    }
+    return "";
+}
+
+void BenchmarkRow::writeCsvHeader(std::ostream& os) const
+{
+    for ( size_t i = 0; i < m_fields.size(); i++ )
+    {
+        os << (i > 0 ? "," : "") << m_fields[i].name;
+    }
+    os << '\n';
+}
+
+void BenchmarkRow::writeCsv(std::ostream& os) const
+{
+    for ( size_t i = 0; i < m_fields.size(); i++ )
+    {
+        // device names have spaces, and may have commas or quotes (RFC 4180: doubled inside the quotes)
+        const Field& field = m_fields[i];
+        os << (i > 0 ? "," : "");
+        if ( !field.is_string || field.value.find_first_of(", \"\r\n") == std::string::npos )
+        {
+            os << field.value;
+            continue;
+        }
+        os << '"';
+        for ( char c : field.value )
+        {
+            if ( c == '"' )
+            {
+                os << '"';
+            }
+            os << c;
+        }
+        os << '"';
+    }
+    os << '\n';
+}
+
+// JSON string with the quotes, backslashes and control characters escaped.
+static void writeJsonString(std::ostream& os, const std::string& value)
+{
+    os << '"';
+    for ( char c : value )
+    {
+        if ( c == '"' || c == '\\' )
+        {
+            os << '\\' << c;
+        }
+        else if ( (unsigned char)c < 0x20 )
+        {
+            char hex[7];
+            std::snprintf(hex, sizeof(hex), "\\u%04x", (unsigned int)(unsigned char)c);
+            os << hex;
+        }
+        else
+        {
+            os << c;
+        }
+    }
+    os << '"';
+}
+
+void BenchmarkRow::writeJson(std::ostream& os) const
+{
+    os << '{';
+    for ( size_t i = 0; i < m_fields.size(); i++ )
+    {
+        const Field& field = m_fields[i];
+        os << (i > 0 ? ", " : "");
+        writeJsonString(os, field.name);
+        os << ": ";
+        if ( field.is_string )
+        {
+            writeJsonString(os, field.value);
+        }
+        else
+        {
+            os << field.value;
+        }
+    }
+    os << '}';
+}
+
+int writeBenchmarkReport(const BenchmarkOptions& options, const std::vector<BenchmarkRow>& rows)
+{
+    std::ofstream ofs;
+    if ( !options.output.empty() )
+    {
+        ofs.open(options.output, std::ios::trunc);
+        if ( !ofs )
+        {
+            std::cerr << "Unable to write " << options.output << '\n';
+            return 1;
+        }
+    }
+    std::ostream& os = options.output.empty() ? std::cout : ofs;
+
+    if ( options.format == "json" )
+    {
+        os << "[\n";
+        for ( size_t i = 0; i < rows.size(); i++ )
+        {
+            os << "  ";
+            rows[i].writeJson(os);
+            os << (i + 1 < rows.size() ? "," : "") << '\n';
+        }
+        os << "]\n";
+    }
+    else
+    {
+        if ( !rows.empty() )
+        {
+            rows[0].writeCsvHeader(os);
+        }
+        for ( const BenchmarkRow& row : rows )
+        {
+            row.writeCsv(os);
+        }
+    }
+
+    for ( const BenchmarkRow& row : rows )
+    {
+        if ( row.get("check") == "fail" )
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
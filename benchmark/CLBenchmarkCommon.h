@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CLSimpleWrapper.h"
+
+// Command line, timing and report helpers shared by the benchmarks.
+
+// options of every benchmark, a benchmark adds its own ones by deriving from it and sets its defaults.
+struct BenchmarkOptions
+{
+    int platformId = -1;
+    int deviceId = -1;
+    std::vector<size_t> sizes;
+    size_t repeats = 3;
+    std::string format = "csv";     // "csv" or "json"
+    std::string output;             // empty: stdout
+};
+
+// --list, --platform, --device, --sizes, --repeats, --format and --output are parsed here, any other option
+//  is passed to parse_option (value is empty for the options listed in flags). parse_option returns false
+//  for an unknown option. False on error, with the reason printed.
+bool parseBenchmarkOptions(int argc, char* argv[], BenchmarkOptions& options,
+    const std::function<bool(const std::string& arg, const std::string& value)>& parse_option,
+    const std::vector<std::string>& flags = std::vector<std::string>());
+
+std::vector<std::string> splitList(const std::string& list);
+
+double getElapsedMs(std::chrono::steady_clock::time_point start);
+
+// total device time of the category per run, 0 when profiling is not available.
+double getCategoryTime(const std::vector<CLProfileStats>& stats, const std::string& category, size_t repeats);
+
+// times per run in ms, device times from the profiling of the wrapper.
+struct BenchmarkTiming
+{
+    double wall_ms;         // host time of run, including the transfers
+    double upload_ms;       // "write" commands
+    double kernel_ms;       // "kernel" commands
+    double readback_ms;     // "read" commands
+    bool is_pass;           // every run returned true
+};
+
+// run once to warm up (program build, buffer creation), then repeats times. run returns true when the result
+//  matches the reference.
+BenchmarkTiming measureBenchmark(CLSimpleWrapper& wrapper, size_t repeats, const std::function<bool()>& run);
+
+// one line of the report, the columns in order.
+class BenchmarkRow
+{
+public:
+    BenchmarkRow& add(const std::string& name, const std::string& value);
+
+    BenchmarkRow& add(const std::string& name, const char* value);
+
+    template<typename T>
+    BenchmarkRow& add(const std::string& name, T value)
+    {
+        std::ostringstream oss;
+        oss << value;
+        m_fields.push_back(Field{ name, oss.str(), false });
+        return *this;
+    }
+
+    // value of the column, empty when there is none.
+    std::string get(const std::string& name) const;
+
+    void writeCsvHeader(std::ostream& os) const;
+
+    void writeCsv(std::ostream& os) const;
+
+    void writeJson(std::ostream& os) const;
+
+private:
+    struct Field
+    {
+        std::string name;
+        std::string value;
+        bool is_string;
+    };
+
+    std::vector<Field> m_fields;
+};
+
+// write the rows as CSV or JSON into the output of the options. Returns the exit code of the benchmark:
+//  1 when the report can't be written or a "check" column is "fail", 0 otherwise.
+int writeBenchmarkReport(const BenchmarkOptions& options, const std::vector<BenchmarkRow>& rows);
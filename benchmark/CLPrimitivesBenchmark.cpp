@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "CLPrimitives.h"
+#include "CLBenchmarkCommon.h"
+
+// Primitives benchmark: reduce, scan, compact and sort over a sweep of element counts, checked against the
+//  host (std::) implementation. The throughput is reported in GB/s of the bytes an ideal implementation reads
+//  and writes once, from the device kernel time and from the host wall time (including the transfers).
+//
+//  usage: CLPrimitivesBenchmark [--list] [--platform N] [--device N] [--sizes 1048576,16777216]
+//      [--primitives reduce_sum,reduce_min,reduce_max,scan_inclusive,scan_exclusive,compact,sort_uint,sort_float]
+//      [--repeats N] [--format csv|json] [--output path]
+
+struct PrimitivesBenchmarkOptions : BenchmarkOptions
+{
+    std::vector<std::string> primitives = { "reduce_sum", "reduce_min", "reduce_max", "scan_inclusive",
+        "scan_exclusive", "compact", "sort_uint", "sort_float" };
+
+    PrimitivesBenchmarkOptions()
+    {
+        sizes = { 1 << 20, 1 << 24 };
+    }
+};
+
+static bool parseOptions(int argc, char* argv[], PrimitivesBenchmarkOptions& options)
+{
+    return parseBenchmarkOptions(argc, argv, options, [&options](const std::string& arg, const std::string& value)
+    {
+        if ( arg == "--primitives" )
+        {
+            options.primitives = splitList(value);
+            return true;
+        }
+        return false;
+    });
+}
+
+static double getGbps(double bytes, double ms)
+{
+    return ms > 0 ? bytes / (ms * 1e6) : 0;
+}
+
+// row has the device, primitive and size columns, bytes are read and written once by an ideal implementation.
+//  Times are in ms and averaged over the repeats, kernel_ms of every pass and wall_ms including the transfers.
+static void measure(CLPrimitives& primitives, const PrimitivesBenchmarkOptions& options, BenchmarkRow row, double bytes,
+    const std::function<bool()>& run, std::vector<BenchmarkRow>& rows)
+{
+    BenchmarkTiming timing = measureBenchmark(primitives.getWrapper(), options.repeats, run);
+    std::string check = timing.is_pass ? "pass" : "fail";
+    row.add("kernel_ms", timing.kernel_ms).add("kernel_gbps", getGbps(bytes, timing.kernel_ms))
+        .add("wall_ms", timing.wall_ms).add("wall_gbps", getGbps(bytes, timing.wall_ms)).add("check", check);
+    rows.push_back(row);
+
+    std::cerr << row.get("primitive") << " " << row.get("size") << ": kernel " << timing.kernel_ms << " ms ("
+        << getGbps(bytes, timing.kernel_ms) << " GB/s), wall " << timing.wall_ms << " ms ("
+        << getGbps(bytes, timing.wall_ms) << " GB/s), " << check << '\n';
+}
+
+static void benchmarkSize(CLPrimitives& primitives, const PrimitivesBenchmarkOptions& options, const std::string& device,
+    size_t size, std::vector<BenchmarkRow>& rows)
+{
+    std::vector<unsigned int> values(size);
+    std::vector<int> signed_values(size);
+    std::vector<float> float_values(size);
+    for ( size_t i = 0; i < size; i++ )
+    {
+        values[i] = (unsigned int)rand();
+        signed_values[i] = rand() - RAND_MAX / 2;
+        float_values[i] = (float)(rand() - RAND_MAX / 2) / 1024.0f;
+    }
+    std::vector<unsigned int> output(size);
+    std::vector<int> signed_output(size);
+    std::vector<float> float_output(size);
+
+    for ( const std::string& primitive : options.primitives )
+    {
+        BenchmarkRow row;
+        row.add("device", device).add("primitive", primitive).add("size", size);
+
+        if ( primitive == "reduce_sum" )
+        {
+            // unsigned int: the overflow wraps around the same way on the host and on the device
+            unsigned int expected = 0;
+            for ( unsigned int value : values )
+            {
+                expected += value;
+            }
+            double bytes = (double)size * sizeof(unsigned int);
+            measure(primitives, options, row, bytes, [&]()
+                {
+                    return primitives.reduce(values.data(), size) == expected;
+                }, rows);
+        }
+        else if ( primitive == "reduce_min" || primitive == "reduce_max" )
+        {
+            bool is_min = primitive == "reduce_min";
+            int expected = is_min ? *std::min_element(signed_values.begin(), signed_values.end()) :
+                *std::max_element(signed_values.begin(), signed_values.end());
+            double bytes = (double)size * sizeof(int);
+            measure(primitives, options, row, bytes, [&]()
+                {
+                    return primitives.reduce(signed_values.data(), size,
+                        is_min ? CLPrimitives::ReduceOp::Min : CLPrimitives::ReduceOp::Max) == expected;
+                }, rows);
+        }
+        else if ( primitive == "scan_inclusive" || primitive == "scan_exclusive" )
+        {
+            bool is_exclusive = primitive == "scan_exclusive";
+            std::vector<unsigned int> expected(size);
+            unsigned int sum = 0;
+            for ( size_t i = 0; i < size; i++ )
+            {
+                expected[i] = is_exclusive ? sum : sum + values[i];
+                sum += values[i];
+            }
+            double bytes = 2.0 * size * sizeof(unsigned int);
+            measure(primitives, options, row, bytes, [&]()
+                {
+                    primitives.scan(values.data(), output.data(), size, is_exclusive);
+                    return output == expected;
+                }, rows);
+        }
+        else if ( primitive == "compact" )
+        {
+            // keep the positive values, about one half
+            std::vector<unsigned int> flags(size);
+            std::vector<float> expected;
+            for ( size_t i = 0; i < size; i++ )
+            {
+                flags[i] = float_values[i] > 0.0f ? 1 : 0;
+                if ( flags[i] )
+                {
+                    expected.push_back(float_values[i]);
+                }
+            }
+            double bytes = (double)size * (sizeof(float) + sizeof(unsigned int)) + (double)expected.size() * sizeof(float);
+            measure(primitives, options, row, bytes, [&]()
+                {
+                    size_t selected = primitives.compact(float_values.data(), flags.data(), float_output.data(), size);
+                    return selected == expected.size() && std::equal(expected.begin(), expected.end(), float_output.begin());
+                }, rows);
+        }
+        else if ( primitive == "sort_uint" )
+        {
+            std::vector<unsigned int> expected = values;
+            std::sort(expected.begin(), expected.end());
+            double bytes = 2.0 * size * sizeof(unsigned int);
+            measure(primitives, options, row, bytes, [&]()
+                {
+                    output = values;
+                    primitives.sort(output.data(), size);
+                    return output == expected;
+                }, rows);
+        }
+        else if ( primitive == "sort_float" )
+        {
+            std::vector<float> expected = float_values;
+            std::sort(expected.begin(), expected.end());
+            double bytes = 2.0 * size * sizeof(float);
+            measure(primitives, options, row, bytes, [&]()
+                {
+                    float_output = float_values;
+                    primitives.sort(float_output.data(), size);
+                    return float_output == expected;
+                }, rows);
+        }
+        else
+        {
+            std::cerr << "Unknown primitive " << primitive << ", skipped\n";
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    PrimitivesBenchmarkOptions options;
+    if ( !parseOptions(argc, argv, options) )
+    {
+        return 1;
+    }
+
+    std::shared_ptr<CLSession> session = CLSession::create(options.platformId, options.deviceId, CL_QUEUE_PROFILING_ENABLE);
+    if ( !session->isValid() )
+    {
+        return 1;
+    }
+
+    std::string device = CLSession::getDeviceName(session->getDevice());
+    std::cerr << "Device: " << device << '\n';
+
+    CLPrimitives primitives(session);
+    primitives.enableProfiling();
+
+    std::vector<BenchmarkRow> rows;
+    for ( size_t size : options.sizes )
+    {
+        benchmarkSize(primitives, options, device, size, rows);
+    }
+
+    return writeBenchmarkReport(options, rows);
+}
@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "CLGemm.h"
+#include "CLSparse.h"
+#include "CLBenchmarkCommon.h"
+
+// Sparse benchmark: SpMV and SpMM of random square float matrices over a sweep of sizes and densities, next to the
+//  dense path (CLGemm) on the same matrix. Every result is checked against the host reference. The report gives
+//  the device memory of the matrix, and the GFLOP/s from the kernel time: "useful" counts 2 flops per nonzero
+//  (and per column of B), so that the sparse and dense rows compare the time to the same result.
+//
+//  usage: CLSparseBenchmark [--list] [--platform N] [--device N] [--sizes 1024,4096] [--densities 0.001,0.01]
+//      [--distributions uniform,powerlaw] [--columns N] [--methods csr_scalar,csr_vector,ell,sliced_ell,dense,
+//      spmm_csr,spmm_dense] [--repeats N] [--format csv|json] [--output path]
+
+// slice height of sliced_ell, the dense path is skipped above this matrix size (bytes)
+#define SLICE_HEIGHT 32
+#define MAX_DENSE_BYTES (1024ULL * 1024 * 1024)
+
+struct SparseBenchmarkOptions : BenchmarkOptions
+{
+    std::vector<double> densities = { 0.001, 0.01 };
+    std::vector<std::string> distributions = { "uniform", "powerlaw" };
+    size_t columns = 16;    // columns of B for SpMM
+    std::vector<std::string> methods = { "csr_scalar", "csr_vector", "ell", "sliced_ell", "dense",
+        "spmm_csr", "spmm_dense" };
+
+    SparseBenchmarkOptions()
+    {
+        sizes = { 1024, 4096 };
+        repeats = 5;
+    }
+};
+
+// what a line of the report measures, the times are added by measure().
+struct SparseCase
+{
+    std::string device;
+    std::string method;
+    std::string distribution;
+    size_t size;
+    double density;
+    size_t nnz;
+    size_t footprint;       // device memory of the matrix, bytes
+    double useful_flops;    // 2 per nonzero and column of B
+    double flops;           // executed, including the padding of ELL and the zeros of the dense path
+};
+
+static bool parseOptions(int argc, char* argv[], SparseBenchmarkOptions& options)
+{
+    return parseBenchmarkOptions(argc, argv, options, [&options](const std::string& arg, const std::string& value)
+    {
+        if ( arg == "--densities" )
+        {
+            options.densities.clear();
+            for ( const std::string& density : splitList(value) )
+            {
+                options.densities.push_back(std::stod(density));
+            }
+        }
+        else if ( arg == "--distributions" )
+        {
+            options.distributions = splitList(value);
+        }
+        else if ( arg == "--columns" )
+        {
+            options.columns = std::max<size_t>(1, std::stoul(value));
+        }
+        else if ( arg == "--methods" )
+        {
+            options.methods = splitList(value);
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    });
+}
+
+static double getGflops(double flops, double ms)
+{
+    return ms > 0 ? flops / (ms * 1e6) : 0;
+}
+
+// random square matrix with density * size nonzeros per row on average. uniform: row lengths within
+//  [0, 2 * mean], powerlaw: most rows short and a few very long ones (Pareto, alpha 2), as in graphs.
+static CLSparse::Csr<float> makeMatrix(size_t size, double density, const std::string& distribution)
+{
+    double mean = std::max(1.0, density * size);
+    std::vector<cl_uint> row_indices;
+    std::vector<cl_uint> col_indices;
+    std::vector<float> values;
+    for ( size_t row = 0; row < size; row++ )
+    {
+        double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+        double length = (distribution == "powerlaw") ? 0.5 * mean / std::sqrt(u) : 2.0 * mean * u;
+        size_t count = std::min(size, (size_t)length);
+        for ( size_t i = 0; i < count; i++ )
+        {
+            row_indices.push_back((cl_uint)row);
+            col_indices.push_back((cl_uint)(rand() % size));
+            values.push_back((float)(rand() % 200 - 100) / 100.0f);
+        }
+    }
+    return CLSparse::fromCoo(size, size, row_indices, col_indices, values);
+}
+
+// times are in ms and averaged over the repeats, kernel_ms of the "kernel" commands and wall_ms including the transfers.
+static void addRow(const SparseCase& c, const BenchmarkTiming& timing, const std::string& check, std::vector<BenchmarkRow>& rows)
+{
+    BenchmarkRow row;
+    row.add("device", c.device).add("method", c.method).add("distribution", c.distribution).add("size", c.size)
+        .add("density", c.density).add("nnz", c.nnz).add("footprint_bytes", c.footprint)
+        .add("kernel_ms", timing.kernel_ms).add("useful_gflops", getGflops(c.useful_flops, timing.kernel_ms))
+        .add("gflops", getGflops(c.flops, timing.kernel_ms)).add("wall_ms", timing.wall_ms)
+        .add("wall_useful_gflops", getGflops(c.useful_flops, timing.wall_ms)).add("check", check);
+    rows.push_back(row);
+}
+
+static void measure(CLSimpleWrapper& wrapper, const SparseBenchmarkOptions& options, const SparseCase& c,
+    const std::function<bool()>& run, std::vector<BenchmarkRow>& rows)
+{
+    BenchmarkTiming timing = measureBenchmark(wrapper, options.repeats, run);
+    std::string check = timing.is_pass ? "pass" : "fail";
+    addRow(c, timing, check, rows);
+
+    std::cerr << c.method << " " << c.distribution << " " << c.size << " " << c.density
+        << ": " << c.footprint << " bytes, kernel " << timing.kernel_ms << " ms ("
+        << getGflops(c.useful_flops, timing.kernel_ms) << " useful GFLOP/s), wall " << timing.wall_ms << " ms, "
+        << check << '\n';
+}
+
+static void benchmarkMatrix(CLSparse& sparse, CLGemm& gemm, const SparseBenchmarkOptions& options, SparseCase sparse_case,
+    std::vector<BenchmarkRow>& rows)
+{
+    size_t size = sparse_case.size;
+    size_t columns = options.columns;
+    CLSparse::Csr<float> csr = makeMatrix(size, sparse_case.density, sparse_case.distribution);
+    sparse_case.nnz = csr.values.size();
+
+    CLSparse::RowStats stats = CLSparse::getRowStats(csr.row_offsets);
+    std::cerr << sparse_case.distribution << " " << size << " " << sparse_case.density << ": " << sparse_case.nnz
+        << " nonzeros, row length min " << stats.min_length << ", max " << stats.max_length << ", mean "
+        << stats.mean_length << ", stddev " << stats.stddev << ", auto kernel "
+        << (CLSparse::SpmvKernel::ScalarRow == CLSparse::selectSpmvKernel(stats) ? "csr_scalar" : "csr_vector")
+        << '\n';
+
+    std::vector<float> x(size);
+    std::vector<float> b(size * columns);
+    for ( float& value : x )
+    {
+        value = (float)(rand() % 200 - 100) / 100.0f;
+    }
+    for ( float& value : b )
+    {
+        value = (float)(rand() % 200 - 100) / 100.0f;
+    }
+    std::vector<float> y(size);
+    std::vector<float> y_expected(size);
+    std::vector<float> c(size * columns);
+    std::vector<float> c_expected(size * columns);
+    CLSparse::spmvReference(csr, x.data(), y_expected.data());
+    CLSparse::spmmReference(csr, b.data(), c_expected.data(), columns);
+
+    std::vector<float> dense;
+    bool is_dense = (double)size * size * sizeof(float) <= (double)MAX_DENSE_BYTES;
+
+    for ( const std::string& method : options.methods )
+    {
+        sparse_case.method = method;
+        bool is_spmm = method.compare(0, 5, "spmm_") == 0;
+        sparse_case.useful_flops = 2.0 * sparse_case.nnz * (is_spmm ? columns : 1);
+        sparse_case.flops = sparse_case.useful_flops;
+        sparse_case.footprint = CLSparse::getFootprint(csr);
+
+        auto check_y = [&]()
+        {
+            return CLGemm::verify(y_expected.data(), y.data(), size, 1e-4);
+        };
+        auto check_c = [&]()
+        {
+            return CLGemm::verify(c_expected.data(), c.data(), size * columns, 1e-4);
+        };
+
+        if ( method == "csr_scalar" || method == "csr_vector" )
+        {
+            CLSparse::SpmvKernel kernel = (method == "csr_scalar") ?
+                CLSparse::SpmvKernel::ScalarRow : CLSparse::SpmvKernel::VectorRow;
+            measure(sparse.getWrapper(), options, sparse_case, [&]()
+                {
+                    sparse.spmv(csr, x.data(), y.data(), kernel);
+                    return check_y();
+                }, rows);
+        }
+        else if ( method == "ell" || method == "sliced_ell" )
+        {
+            CLSparse::Ell<float> ell = CLSparse::toEll(csr, (method == "ell") ? 0 : SLICE_HEIGHT);
+            sparse_case.footprint = CLSparse::getFootprint(ell);
+            sparse_case.flops = 2.0 * ell.values.size();
+            measure(sparse.getWrapper(), options, sparse_case, [&]()
+                {
+                    sparse.spmv(ell, x.data(), y.data());
+                    return check_y();
+                }, rows);
+        }
+        else if ( method == "dense" || method == "spmm_dense" )
+        {
+            sparse_case.footprint = size * size * sizeof(float);
+            sparse_case.flops = 2.0 * size * size * (is_spmm ? columns : 1);
+            if ( !is_dense )
+            {
+                addRow(sparse_case, BenchmarkTiming(), "skipped", rows);
+                continue;
+            }
+            if ( dense.empty() )
+            {
+                dense.resize(size * size);
+                CLSparse::toDense(csr, dense.data());
+            }
+
+            // matrix-vector: one work item per row of the result, the vector is a single column
+            CLGemm::Variant variant = is_spmm ? CLGemm::Variant::TiledVector : CLGemm::Variant::Naive;
+            measure(gemm.getWrapper("float"), options, sparse_case, [&]()
+                {
+                    gemm.multiply(dense.data(), is_spmm ? b.data() : x.data(), is_spmm ? c.data() : y.data(),
+                        size, is_spmm ? columns : 1, size, variant);
+                    return is_spmm ? check_c() : check_y();
+                }, rows);
+        }
+        else if ( method == "spmm_csr" )
+        {
+            measure(sparse.getWrapper(), options, sparse_case, [&]()
+                {
+                    sparse.spmm(csr, b.data(), c.data(), columns);
+                    return check_c();
+                }, rows);
+        }
+        else
+        {
+            std::cerr << "Unknown method " << method << ", skipped\n";
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    SparseBenchmarkOptions options;
+    if ( !parseOptions(argc, argv, options) )
+    {
+        return 1;
+    }
+
+    std::shared_ptr<CLSession> session = CLSession::create(options.platformId, options.deviceId, CL_QUEUE_PROFILING_ENABLE);
+    if ( !session->isValid() )
+    {
+        return 1;
+    }
+
+    SparseCase sparse_case = SparseCase();
+    sparse_case.device = CLSession::getDeviceName(session->getDevice());
+    std::cerr << "Device: " << sparse_case.device << '\n';
+
+    CLSparse sparse(session);
+    sparse.enableProfiling();
+    CLGemm gemm(session);
+    gemm.enableProfiling();
+
+    std::vector<BenchmarkRow> rows;
+    for ( size_t size : options.sizes )
+    {
+        for ( double density : options.densities )
+        {
+            for ( const std::string& distribution : options.distributions )
+            {
+                sparse_case.size = size;
+                sparse_case.density = density;
+                sparse_case.distribution = distribution;
+                benchmarkMatrix(sparse, gemm, options, sparse_case, rows);
+            }
+        }
+    }
+
+    return writeBenchmarkReport(options, rows);
+}
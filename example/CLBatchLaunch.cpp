@@ -0,0 +1,88 @@
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "CLSimpleWrapper.h"
+
+// currently simplify platform and device selection using this
+#define PLATFORM_ID -1
+#define DEVICE_ID -1
+
+// many small independent problems: a polynomial evaluated over a short vector, different size for each job
+#define JOB_COUNT 1000
+#define MAX_JOB_SIZE 512
+
+std::string ClSrcPolynomial = R"CLC(
+__kernel void polynomial(__global const float* x,
+    __global float* y,
+    const float a,
+    const float b,
+    const float c)
+{
+    size_t i = get_global_id(0);
+    y[i] = (a * x[i] + b) * x[i] + c;
+}
+)CLC";
+
+int main()
+{
+    std::shared_ptr<CLSession> session = CLSession::create(PLATFORM_ID, DEVICE_ID);
+    if ( !session->isValid() )
+    {
+        return 1;
+    }
+    std::cout << "Device: " << CLSession::getDeviceName(session->getDevice()) << "\n";
+
+    CLSimpleWrapper cl_wrapper(session);
+    cl_int error = cl_wrapper.createCLKernel(ClSrcPolynomial, "polynomial");
+    CLSimpleWrapper::checkCLError(error, "Build Program Failed");
+
+    std::vector<std::vector<float> > inputs(JOB_COUNT);
+    std::vector<std::vector<float> > outputs(JOB_COUNT);
+    std::vector<float> coefficients(JOB_COUNT);
+    std::vector<CLBatchJob> jobs(JOB_COUNT);
+    float b = 2.0f;
+    float c = 1.0f;
+    for ( size_t j = 0; j < JOB_COUNT; j++ )
+    {
+        size_t size = 1 + rand() % MAX_JOB_SIZE;
+        inputs[j].resize(size);
+        outputs[j].resize(size);
+        for ( size_t i = 0; i < size; i++ )
+        {
+            inputs[j][i] = (float)(i % 16);
+        }
+        coefficients[j] = (float)(j % 8);
+
+        jobs[j].setInput(0, inputs[j].data(), size * sizeof(float));
+        jobs[j].setOutput(1, outputs[j].data(), size * sizeof(float));
+        jobs[j].setArg(2, &coefficients[j], sizeof(float));
+        jobs[j].setArg(3, &b, sizeof(float));
+        jobs[j].setArg(4, &c, sizeof(float));
+        jobs[j].setWorkSize(1, &size);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    cl_wrapper.executeBatch(jobs);
+    auto finish = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = finish - start;
+
+    size_t error_count = 0;
+    for ( size_t j = 0; j < JOB_COUNT; j++ )
+    {
+        for ( size_t i = 0; i < inputs[j].size(); i++ )
+        {
+            float x = inputs[j][i];
+            if ( outputs[j][i] != (coefficients[j] * x + b) * x + c )
+            {
+                error_count++;
+            }
+        }
+    }
+
+    std::cout << JOB_COUNT << " jobs in one batch: " << (error_count == 0 ? "PASS" : "FAIL")
+        << ", elapsed time: " << elapsed.count() << " s\n";
+    return error_count == 0 ? 0 : 1;
+}
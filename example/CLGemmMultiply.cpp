@@ -0,0 +1,120 @@
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CLGemm.h"
+
+// currently simplify platform and device selection using this
+#define PLATFORM_ID -1
+#define DEVICE_ID -1
+
+// non-square, and not a multiple of the tile size on purpose
+#define MATRIX_M 517
+#define MATRIX_N 389
+#define MATRIX_K 263
+#define MAX_VAL 100
+#define MIN_VAL 1
+#define HYBRID_RUNS 3
+
+// run every GEMM variant for the element type, then the host and hybrid backends,
+//  and check the result against the host reference. host backend only without a device.
+template<typename T>
+bool testGemm(CLGemm& gemm, std::string type_name, double tolerance)
+{
+    std::vector<T> matrixA(MATRIX_M * MATRIX_K);
+    std::vector<T> matrixB(MATRIX_K * MATRIX_N);
+    std::vector<T> matrixResult(MATRIX_M * MATRIX_N);
+    std::vector<T> matrixReference(MATRIX_M * MATRIX_N);
+
+    for ( T& value : matrixA )
+    {
+        value = (T)((rand() % (MAX_VAL - MIN_VAL)) + MIN_VAL);
+    }
+    for ( T& value : matrixB )
+    {
+        value = (T)((rand() % (MAX_VAL - MIN_VAL)) + MIN_VAL);
+    }
+    CLGemm::multiplyReference(matrixA.data(), matrixB.data(), matrixReference.data(), MATRIX_M, MATRIX_N, MATRIX_K);
+
+    std::vector<std::pair<CLGemm::Backend, CLGemm::Variant> > runs;
+    runs.push_back(std::make_pair(CLGemm::Backend::Host, CLGemm::Variant::TiledVector));
+    if ( CLGemm::Backend::Host != gemm.getBackend() )
+    {
+        CLGemm::Variant variants[] = { CLGemm::Variant::Naive, CLGemm::Variant::NaiveTransposed,
+            CLGemm::Variant::Tiled, CLGemm::Variant::TiledVector };
+        for ( CLGemm::Variant variant : variants )
+        {
+            runs.push_back(std::make_pair(CLGemm::Backend::Device, variant));
+        }
+        // the split converges over the calls
+        runs.insert(runs.end(), HYBRID_RUNS, std::make_pair(CLGemm::Backend::Hybrid, CLGemm::Variant::TiledVector));
+    }
+
+    bool is_passed = true;
+    for ( const auto& run : runs )
+    {
+        gemm.setBackend(run.first);
+        double host_ratio = gemm.getHostRatio();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        gemm.multiply(matrixA.data(), matrixB.data(), matrixResult.data(), MATRIX_M, MATRIX_N, MATRIX_K, run.second);
+        auto finish = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = finish - start;
+
+        bool is_correct = CLGemm::verify(matrixReference.data(), matrixResult.data(), matrixResult.size(), tolerance);
+        is_passed = is_passed && is_correct;
+        std::cout << type_name << " ";
+        if ( CLGemm::Backend::Host == run.first )
+        {
+            std::cout << "host";
+        }
+        else if ( CLGemm::Backend::Hybrid == run.first )
+        {
+            std::cout << "hybrid (" << host_ratio * 100.0 << "% of the rows on the host)";
+        }
+        else
+        {
+            std::cout << CLGemm::getVariantName(run.second);
+        }
+        std::cout << ": " << (is_correct ? "PASS" : "FAIL") << ", elapsed time: " << elapsed.count() << " s\n";
+    }
+    gemm.setBackend(CLGemm::Backend::Device);
+
+    return is_passed;
+}
+
+int main()
+{
+    std::shared_ptr<CLSession> session = CLSession::create(PLATFORM_ID, DEVICE_ID);
+    if ( session->isValid() )
+    {
+        std::cout << "Device: " << CLSession::getDeviceName(session->getDevice()) << "\n";
+    }
+    else
+    {
+        std::cout << "No device, host backend only\n";
+    }
+    std::cout << "C (" << MATRIX_M << "x" << MATRIX_N << ") = A (" << MATRIX_M << "x" << MATRIX_K
+        << ") * B (" << MATRIX_K << "x" << MATRIX_N << ")\n";
+
+    CLGemm gemm(session);
+
+    bool is_passed = testGemm<int>(gemm, "int", 0.0);
+    is_passed = testGemm<float>(gemm, "float", 1e-4) && is_passed;
+
+    std::string extensions = session->isValid() ?
+        CLSession::getDeviceInfoString(session->getDevice(), CL_DEVICE_EXTENSIONS) : "";
+    if ( !session->isValid() || extensions.find("cl_khr_fp64") != std::string::npos )
+    {
+        is_passed = testGemm<double>(gemm, "double", 1e-10) && is_passed;
+    }
+    else
+    {
+        std::cout << "double: skipped, cl_khr_fp64 not supported by the device\n";
+    }
+
+    return is_passed ? 0 : 1;
+}
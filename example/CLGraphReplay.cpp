@@ -0,0 +1,102 @@
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "CLSimpleWrapper.h"
+
+// currently simplify platform and device selection using this
+#define PLATFORM_ID -1
+#define DEVICE_ID -1
+
+// the same small pipeline (write, two kernels, read) run for every frame, only the data changes
+#define FRAME_COUNT 1000
+#define FRAME_SIZE (64 * 1024)
+
+std::string ClSrcPipeline = R"CLC(
+__kernel void scale(__global const float* x,
+    __global float* t,
+    const float a)
+{
+    size_t i = get_global_id(0);
+    t[i] = a * x[i];
+}
+
+__kernel void offset(const float b,
+    __global const float* t,
+    __global float* y)
+{
+    size_t i = get_global_id(0);
+    y[i] = t[i] + b;
+}
+)CLC";
+
+int main()
+{
+    std::shared_ptr<CLSession> session = CLSession::create(PLATFORM_ID, DEVICE_ID);
+    if ( !session->isValid() )
+    {
+        return 1;
+    }
+    std::cout << "Device: " << CLSession::getDeviceName(session->getDevice()) << "\n";
+
+    CLSimpleWrapper cl_wrapper(session);
+    cl_int error = cl_wrapper.createCLKernel(ClSrcPipeline, "scale");
+    CLSimpleWrapper::checkCLError(error, "Build Program Failed");
+
+    // two frames in turn: the next input is prepared while the graph reads the previous one
+    std::vector<std::vector<float> > inputs(2, std::vector<float>(FRAME_SIZE));
+    std::vector<float> output(FRAME_SIZE);
+    float a = 2.0f;
+    float b = 1.0f;
+    size_t global_item_size = FRAME_SIZE;
+
+    // record the first frame, it is executed as usual
+    CLCommandGraph graph;
+    cl_wrapper.beginRecording(graph);
+    cl_wrapper.setKernelBufferArg(0, inputs[0].data(), FRAME_SIZE * sizeof(float));
+    cl_wrapper.setKernelScratchBufferArg(1, FRAME_SIZE * sizeof(float));
+    cl_wrapper.setKernelArg(2, &a, sizeof(float));
+    cl_wrapper.executeKernel(1, &global_item_size, NULL);
+
+    cl_wrapper.selectKernel("offset");
+    cl_wrapper.setKernelArg(0, &b, sizeof(float));
+    cl_wrapper.bindKernelBufferArg(1, 1);
+    cl_wrapper.setKernelBufferArg(2, nullptr, FRAME_SIZE * sizeof(float));
+    cl_wrapper.executeKernel(1, &global_item_size, NULL);
+    cl_wrapper.readBuffer(output.data(), 2, FRAME_SIZE * sizeof(float));
+    cl_wrapper.endRecording();
+    std::cout << graph.getNodes().size() << " commands recorded\n";
+
+    size_t error_count = 0;
+    const void* recorded_input = inputs[0].data();
+    auto start = std::chrono::high_resolution_clock::now();
+    for ( size_t frame = 1; frame < FRAME_COUNT; frame++ )
+    {
+        std::vector<float>& input = inputs[frame % 2];
+        for ( size_t i = 0; i < FRAME_SIZE; i++ )
+        {
+            input[i] = (float)((i + frame) % 1000);
+        }
+        graph.patchHostPointer(recorded_input, input.data());
+        recorded_input = input.data();
+
+        cl_wrapper.replay(graph);
+
+        for ( size_t i = 0; i < FRAME_SIZE; i++ )
+        {
+            if ( output[i] != a * input[i] + b )
+            {
+                error_count++;
+                break;
+            }
+        }
+    }
+    auto finish = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = finish - start;
+
+    std::cout << FRAME_COUNT - 1 << " frames replayed: " << (error_count == 0 ? "PASS" : "FAIL")
+        << ", elapsed time: " << elapsed.count() << " s\n";
+    return error_count == 0 ? 0 : 1;
+}
@@ -8,12 +8,43 @@
 #include <cmath>
 
 #include "CLSimpleWrapper.h"
+#include "CLDeviceSelector.h"
 
 
+// CLListDevices [--calibrate]: print every device, then the device selected for each workload.
+//  the profiles are kept in CLListDevices.profiles, calibration only runs once per device and driver.
 int main(int argc, char* argv[])
 {
     CLSimpleWrapper cl_wrapper;
 
     cl_wrapper.initOpenCL(-1, -1, true);   // print the CL Info without creating initializing.
+
+    CLDeviceSelector selector;
+    selector.setProfileFile("CLListDevices.profiles");
+    selector.enableCalibration(argc > 1 && std::string(argv[1]) == "--calibrate");
+
+    for ( const CLDeviceProfile& profile : selector.getProfiles() )
+    {
+        std::cout << "[" << profile.platform_index << ", " << profile.device_index << "] " << profile.name
+            << ": " << profile.compute_units << " compute units, " << profile.clock_mhz << " MHz, "
+            << (profile.global_mem_bytes >> 20) << " MB global, " << (profile.local_mem_bytes >> 10) << " KB local"
+            << (profile.has_fp64 ? ", fp64" : "") << (profile.is_unified_memory ? ", unified memory" : "");
+        if ( profile.gflops > 0.0 )
+        {
+            std::cout << ", " << profile.gflops << " GFLOP/s, " << profile.gbps << " GB/s";
+        }
+        std::cout << '\n';
+    }
+
+    const char* workload_names[] = { "compute", "compute double", "memory", "latency" };
+    CLWorkload workloads[] = { CLWorkload::Compute, CLWorkload::ComputeDouble, CLWorkload::Memory, CLWorkload::Latency };
+    for ( size_t i = 0; i < 4; i++ )
+    {
+        CLDeviceProfile best;
+        if ( selector.selectDevice(workloads[i], best) )
+        {
+            std::cout << "Best device for " << workload_names[i] << ": " << best.name << '\n';
+        }
+    }
     return 0;
 }
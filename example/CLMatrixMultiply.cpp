@@ -15,6 +15,18 @@
 
 //#define MATRIX_TYPE_DOUBLE
 
+// print the device timings of parallelOpenCLMatrixMult() and write them as Chrome trace
+//#define ENABLE_PROFILING
+
+// search the best local size on the first run, and keep it in CLMatrixMultiply.tuning for the next ones
+//#define ENABLE_AUTOTUNE
+
+#ifdef ENABLE_PROFILING
+#define QUEUE_PROPERTIES CL_QUEUE_PROFILING_ENABLE
+#else
+#define QUEUE_PROPERTIES 0
+#endif
+
 #ifdef MATRIX_TYPE_DOUBLE
     typedef double MATRIX_TYPE;
 #else
@@ -24,6 +36,7 @@
 #define MATRIX_DIMENSION	1000
 #define MAX_VAL 1000
 #define MIN_VAL 1
+#define RESIDENT_REQUESTS 10
 
 // square MatrixMultiplication: A*B=C, where each matrix is of dimension MxM
 //  this example linearize the matrix into array.
@@ -102,12 +115,33 @@ std::string ClSrcStrMulMatDoubleTrans =
     c[index] = sum;\
 }";
 
+// one templated source for every element type and size: T and M are given as -D defines at build time,
+//  so M is a compile time constant and the loop over k can be fully unrolled.
+std::string ClSrcMulMatTemplate = R"CLC(
+#ifdef USE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+__kernel void multiplyMatricesFixed(__global const T* a,
+    __global const T* b,
+    __global T* c)
+{
+    int colIndex = get_global_id(0);
+    int rowIndex = get_global_id(1);
+    T sum = 0;
+    for ( int k = 0; k < M; k++ )
+    {
+        sum += a[rowIndex * M + k] * b[k * M + colIndex];
+    }
+    c[(rowIndex * M) + colIndex] = sum;
+}
+)CLC";
+
 void parallelOpenCLMatrixMultTrans(MATRIX_TYPE* matrixA, MATRIX_TYPE* matrixBTrans, MATRIX_TYPE* matrixResult)
 {
-    CLSimpleWrapper cl_wrapper;
+    // context and queue are created by the first call only, and shared by the following ones.
+    CLSimpleWrapper cl_wrapper(CLSession::getShared(PLATFORM_ID, DEVICE_ID, QUEUE_PROPERTIES));
 
-    cl_wrapper.initOpenCL(PLATFORM_ID, DEVICE_ID, false);   // use first platform and device
-    //cl_wrapper.createCLCommandQueue();
 #ifdef MATRIX_TYPE_DOUBLE
     cl_wrapper.createCLKernel(ClSrcStrMulMatDoubleTrans, "multiplyMatricesTrans");   // integer matrix multiplication.
 #else
@@ -126,9 +160,15 @@ void parallelOpenCLMatrixMultTrans(MATRIX_TYPE* matrixA, MATRIX_TYPE* matrixBTra
 
 void parallelOpenCLMatrixMult(MATRIX_TYPE* matrixA, MATRIX_TYPE* matrixB, MATRIX_TYPE* matrixResult)
 {
-    CLSimpleWrapper cl_wrapper;
+    CLSimpleWrapper cl_wrapper(CLSession::getShared(PLATFORM_ID, DEVICE_ID, QUEUE_PROPERTIES));
 
-    cl_wrapper.initOpenCL(PLATFORM_ID, DEVICE_ID, false);   // use first platform and device
+#ifdef ENABLE_PROFILING
+    cl_wrapper.enableProfiling();
+#endif
+#ifdef ENABLE_AUTOTUNE
+    cl_wrapper.setTuningFile("CLMatrixMultiply.tuning");
+    cl_wrapper.enableAutotune();
+#endif
 #ifdef MATRIX_TYPE_DOUBLE
     cl_wrapper.createCLKernel(ClSrcStrMulMatDouble, "multiplyMatrices");   // integer matrix multiplication.
 #else
@@ -143,6 +183,155 @@ void parallelOpenCLMatrixMult(MATRIX_TYPE* matrixA, MATRIX_TYPE* matrixB, MATRIX
     size_t global_item_size[2] = { MATRIX_DIMENSION , MATRIX_DIMENSION };   // size of matrix
     cl_wrapper.executeKernel(2, global_item_size, NULL);
     cl_wrapper.readBuffer(matrixResult, 2, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+
+#ifdef ENABLE_PROFILING
+    for ( const CLProfileStats& stat : cl_wrapper.getProfilingStats() )
+    {
+        std::cout << stat.category << " " << stat.name << ": count " << stat.count
+            << ", total " << stat.total_ms << " ms, min " << stat.min_ms << " ms, max " << stat.max_ms << " ms\n";
+    }
+    cl_wrapper.writeProfilingTrace("CLMatrixMultiply_trace.json");
+#endif
+}
+
+// run both kernels with a single program build and a single context:
+//  the kernels are fetched by name, and matrix A and the result buffer are shared between them.
+void parallelOpenCLMatrixMultBoth(MATRIX_TYPE* matrixA, MATRIX_TYPE* matrixB, MATRIX_TYPE* matrixBTrans, MATRIX_TYPE* matrixResult)
+{
+    CLSimpleWrapper cl_wrapper(CLSession::getShared(PLATFORM_ID, DEVICE_ID, QUEUE_PROPERTIES));
+
+#ifdef MATRIX_TYPE_DOUBLE
+    std::string cl_src = ClSrcStrMulMatDouble + ClSrcStrMulMatDoubleTrans;
+#else
+    std::string cl_src = ClSrcStrMulMatInt + ClSrcStrMulMatIntTrans;
+#endif
+    cl_wrapper.createCLKernel(cl_src, "multiplyMatrices");     // builds both kernels, selects multiplyMatrices
+    cl_wrapper.setKernelBufferArg(0, (void*)matrixA, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    cl_wrapper.setKernelBufferArg(1, (void*)matrixB, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    cl_wrapper.setKernelBufferArg(2, nullptr, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    cl_int matrix_dimension = MATRIX_DIMENSION;
+    cl_wrapper.setKernelArg(3, &matrix_dimension, sizeof(cl_int));
+
+    size_t global_item_size[2] = { MATRIX_DIMENSION , MATRIX_DIMENSION };   // size of matrix
+    cl_wrapper.executeKernel(2, global_item_size, NULL);
+    cl_wrapper.readBuffer(matrixResult, 2, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+
+    cl_wrapper.selectKernel("multiplyMatricesTrans");
+    cl_wrapper.bindKernelBufferArg(0, 0);   // matrix A is already on the device
+    cl_wrapper.setKernelBufferArg(1, (void*)matrixBTrans, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    cl_wrapper.bindKernelBufferArg(2, 2);
+    cl_wrapper.setKernelArg(3, &matrix_dimension, sizeof(cl_int));
+
+    cl_wrapper.executeKernel(2, global_item_size, NULL);
+    cl_wrapper.readBuffer(matrixResult, 2, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+}
+
+// same as parallelOpenCLMatrixMult(), with the kernel specialized for the element type and the matrix size.
+//  the program is built once per session, selecting the same variant again within a wrapper is a map lookup.
+void parallelOpenCLMatrixMultSpecialized(MATRIX_TYPE* matrixA, MATRIX_TYPE* matrixB, MATRIX_TYPE* matrixResult)
+{
+    CLSimpleWrapper cl_wrapper(CLSession::getShared(PLATFORM_ID, DEVICE_ID, QUEUE_PROPERTIES));
+
+    std::map<std::string, std::string> defines;
+#ifdef MATRIX_TYPE_DOUBLE
+    defines["T"] = "double";
+    defines["USE_FP64"] = "";
+#else
+    defines["T"] = "int";
+#endif
+    defines["M"] = std::to_string(MATRIX_DIMENSION);
+    std::string build_options = CLSimpleWrapper::makeBuildOptions(defines, "-cl-mad-enable");
+
+    cl_int error = cl_wrapper.selectKernelVariant(ClSrcMulMatTemplate, "multiplyMatricesFixed", build_options);
+    CLSimpleWrapper::checkCLError(error, "Build Kernel Variant Failed");
+    cl_wrapper.setKernelBufferArg(0, (void*)matrixA, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    cl_wrapper.setKernelBufferArg(1, (void*)matrixB, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    cl_wrapper.setKernelBufferArg(2, nullptr, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+
+    size_t global_item_size[2] = { MATRIX_DIMENSION , MATRIX_DIMENSION };   // size of matrix
+    cl_wrapper.executeKernel(2, global_item_size, NULL);
+    cl_wrapper.readBuffer(matrixResult, 2, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+}
+
+// split the rows of the result across every device of the platform,
+//  the split follows the measured throughput of each device after the first run.
+void parallelOpenCLMatrixMultMultiDevice(MATRIX_TYPE* matrixA, MATRIX_TYPE* matrixB, MATRIX_TYPE* matrixResult)
+{
+    CLSimpleWrapper cl_wrapper;
+
+    cl_wrapper.initOpenCLMultiDevice(PLATFORM_ID);
+    cl_wrapper.setSplitPolicy(CLSimpleWrapper::SplitPolicy::Throughput);
+#ifdef MATRIX_TYPE_DOUBLE
+    cl_wrapper.createCLKernel(ClSrcStrMulMatDouble, "multiplyMatrices");   // integer matrix multiplication.
+#else
+    cl_wrapper.createCLKernel(ClSrcStrMulMatInt, "multiplyMatrices");   // integer matrix multiplication.
+#endif
+    cl_wrapper.setKernelBufferArg(0, (void*)matrixA, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    cl_wrapper.setKernelBufferArg(1, (void*)matrixB, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    cl_wrapper.setKernelSplitBufferArg(2, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    cl_int matrix_dimension = MATRIX_DIMENSION;
+    cl_wrapper.setKernelArg(3, &matrix_dimension, sizeof(cl_int));
+
+    size_t global_item_size[2] = { MATRIX_DIMENSION , MATRIX_DIMENSION };   // size of matrix
+    cl_wrapper.executeKernelSplit(2, global_item_size, NULL, 1);     // get_global_id(1) is the row index
+    cl_wrapper.readBufferSplit(matrixResult, 2, MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+}
+
+// same as parallelOpenCLMatrixMult(), using host mapped buffers: on CPU and integrated GPU devices,
+//  the device works directly on the page aligned host matrices, so no data is copied at all.
+void parallelOpenCLMatrixMultZeroCopy(MATRIX_TYPE* matrixA, MATRIX_TYPE* matrixB, MATRIX_TYPE* matrixResult)
+{
+    CLSimpleWrapper cl_wrapper;
+
+    cl_wrapper.initOpenCL(PLATFORM_ID, DEVICE_ID, false);   // use first platform and device
+#ifdef MATRIX_TYPE_DOUBLE
+    cl_wrapper.createCLKernel(ClSrcStrMulMatDouble, "multiplyMatrices");   // integer matrix multiplication.
+#else
+    cl_wrapper.createCLKernel(ClSrcStrMulMatInt, "multiplyMatrices");   // integer matrix multiplication.
+#endif
+    cl_wrapper.setBufferMode(CLSimpleWrapper::BufferMode::HostMapped);
+    cl_wrapper.setKernelBufferArg(0, (void*)matrixA, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    cl_wrapper.setKernelBufferArg(1, (void*)matrixB, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    cl_wrapper.setKernelBufferArg(2, (void*)matrixResult, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    cl_int matrix_dimension = MATRIX_DIMENSION;
+    cl_wrapper.setKernelArg(3, &matrix_dimension, sizeof(cl_int));
+
+    size_t global_item_size[2] = { MATRIX_DIMENSION , MATRIX_DIMENSION };   // size of matrix
+    cl_wrapper.executeKernel(2, global_item_size, NULL);
+
+    // map/unmap makes the result visible in matrixResult, this is a no-op copy on host unified memory.
+    void* result = cl_wrapper.mapBuffer(2, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE), CL_MAP_READ);
+    cl_wrapper.unmapBuffer(2, result);
+}
+
+// the same weights (matrix B) multiplied by a new matrix A on every request, one wrapper per request:
+//  B is uploaded by the first request only, the next ones find it resident in the session.
+void parallelOpenCLMatrixMultResident(MATRIX_TYPE* matrixA, MATRIX_TYPE* matrixB, MATRIX_TYPE* matrixResult)
+{
+    for ( int request = 0; request < RESIDENT_REQUESTS; request++ )
+    {
+        CLSimpleWrapper cl_wrapper(CLSession::getShared(PLATFORM_ID, DEVICE_ID, QUEUE_PROPERTIES));
+
+#ifdef MATRIX_TYPE_DOUBLE
+        cl_wrapper.createCLKernel(ClSrcStrMulMatDouble, "multiplyMatrices");   // integer matrix multiplication.
+#else
+        cl_wrapper.createCLKernel(ClSrcStrMulMatInt, "multiplyMatrices");   // integer matrix multiplication.
+#endif
+        cl_wrapper.setKernelBufferArg(0, (void*)matrixA, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+        cl_wrapper.setKernelResidentBufferArg(1, matrixB, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE),
+            "matrixB");
+        cl_wrapper.setKernelBufferArg(2, nullptr, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+        cl_int matrix_dimension = MATRIX_DIMENSION;
+        cl_wrapper.setKernelArg(3, &matrix_dimension, sizeof(cl_int));
+
+        size_t global_item_size[2] = { MATRIX_DIMENSION , MATRIX_DIMENSION };   // size of matrix
+        cl_wrapper.executeKernel(2, global_item_size, NULL);
+        cl_wrapper.readBuffer(matrixResult, 2, MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    }
+
+    CLResidencyCache& cache = CLSession::getShared(PLATFORM_ID, DEVICE_ID, QUEUE_PROPERTIES)->getResidencyCache();
+    std::cout << "Resident hits: " << cache.getHits() << ", misses: " << cache.getMisses()
+        << ", bytes saved: " << cache.getBytesSaved() << ", bytes uploaded: " << cache.getBytesUploaded() << "\n";
 }
 
 void clearMatrix(MATRIX_TYPE* matrix, std::string mat_name)
@@ -157,7 +346,7 @@ void clearMatrix(MATRIX_TYPE* matrix, std::string mat_name)
     }
 }
 
-int main(int argc, char* argv[])
+int main()
 {
     MATRIX_TYPE* matrixA;
     MATRIX_TYPE* matrixB;
@@ -165,11 +354,12 @@ int main(int argc, char* argv[])
     MATRIX_TYPE* matrixResult;
 
     // Initialize matrix with random value
+    //  page aligned allocation, so that the zero-copy example can use them in place.
 
-    matrixA = (MATRIX_TYPE*)malloc(MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
-    matrixB = (MATRIX_TYPE*)malloc(MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
-    matrixBTrans = (MATRIX_TYPE*)malloc(MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
-    matrixResult = (MATRIX_TYPE*)malloc(MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    matrixA = (MATRIX_TYPE*)CLSimpleWrapper::allocHostBuffer(MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    matrixB = (MATRIX_TYPE*)CLSimpleWrapper::allocHostBuffer(MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    matrixBTrans = (MATRIX_TYPE*)CLSimpleWrapper::allocHostBuffer(MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
+    matrixResult = (MATRIX_TYPE*)CLSimpleWrapper::allocHostBuffer(MATRIX_DIMENSION * MATRIX_DIMENSION * sizeof(MATRIX_TYPE));
 
     for ( int i = 0; i < MATRIX_DIMENSION; i++ )
     {
@@ -211,4 +401,71 @@ int main(int argc, char* argv[])
     std::cout << "Elapsed time: " << elapsed.count() << " s\n";
     clearMatrix(matrixResult, "matrixResult");
 
+    std::cout << "------------------------------------------------------------------------ \n";
+    std::cout << "  Calculate Matrix Multiplication using OpenCL (both kernels, single build): \n";
+    std::cout << "------------------------------------------------------------------------ \n";
+    std::cout << "Starting OpenCL (both kernels)... " << std::endl;
+    start = std::chrono::high_resolution_clock::now();
+    parallelOpenCLMatrixMultBoth(matrixA, matrixB, matrixBTrans, matrixResult);
+    finish = std::chrono::high_resolution_clock::now();
+    elapsed = finish - start;
+    std::cout << "Parallel OpenCL (both kernels) ended. " << std::endl;
+    std::cout << "Elapsed time: " << elapsed.count() << " s\n";
+    clearMatrix(matrixResult, "matrixResult");
+
+    std::cout << "------------------------------------------------------------------------ \n";
+    std::cout << "  Calculate Matrix Multiplication using OpenCL (specialized kernel): \n";
+    std::cout << "------------------------------------------------------------------------ \n";
+    std::cout << "Starting OpenCL (specialized kernel)... " << std::endl;
+    start = std::chrono::high_resolution_clock::now();
+    parallelOpenCLMatrixMultSpecialized(matrixA, matrixB, matrixResult);
+    finish = std::chrono::high_resolution_clock::now();
+    elapsed = finish - start;
+    std::cout << "Parallel OpenCL (specialized kernel) ended. " << std::endl;
+    std::cout << "Elapsed time: " << elapsed.count() << " s\n";
+    clearMatrix(matrixResult, "matrixResult");
+
+    std::cout << "------------------------------------------------------------------------ \n";
+    std::cout << "  Calculate Matrix Multiplication using OpenCL (all devices): \n";
+    std::cout << "------------------------------------------------------------------------ \n";
+    std::cout << "Starting OpenCL (all devices)... " << std::endl;
+    start = std::chrono::high_resolution_clock::now();
+    parallelOpenCLMatrixMultMultiDevice(matrixA, matrixB, matrixResult);
+    finish = std::chrono::high_resolution_clock::now();
+    elapsed = finish - start;
+    std::cout << "Parallel OpenCL (all devices) ended. " << std::endl;
+    std::cout << "Elapsed time: " << elapsed.count() << " s\n";
+    clearMatrix(matrixResult, "matrixResult");
+
+    std::cout << "------------------------------------------------------------------------ \n";
+    std::cout << "  Calculate Matrix Multiplication using OpenCL (zero-copy): \n";
+    std::cout << "------------------------------------------------------------------------ \n";
+    std::cout << "Starting OpenCL (zero-copy)... " << std::endl;
+    start = std::chrono::high_resolution_clock::now();
+    parallelOpenCLMatrixMultZeroCopy(matrixA, matrixB, matrixResult);
+    finish = std::chrono::high_resolution_clock::now();
+    elapsed = finish - start;
+    std::cout << "Parallel OpenCL (zero-copy) ended. " << std::endl;
+    std::cout << "Elapsed time: " << elapsed.count() << " s\n";
+    clearMatrix(matrixResult, "matrixResult");
+
+    std::cout << "------------------------------------------------------------------------ \n";
+    std::cout << "  Calculate Matrix Multiplication using OpenCL (resident matrix B): \n";
+    std::cout << "------------------------------------------------------------------------ \n";
+    std::cout << "Starting OpenCL (resident matrix B)... " << std::endl;
+    start = std::chrono::high_resolution_clock::now();
+    parallelOpenCLMatrixMultResident(matrixA, matrixB, matrixResult);
+    finish = std::chrono::high_resolution_clock::now();
+    elapsed = finish - start;
+    std::cout << "Parallel OpenCL (resident matrix B) ended. " << std::endl;
+    std::cout << "Elapsed time: " << elapsed.count() << " s\n";
+    clearMatrix(matrixResult, "matrixResult");
+
+    CLSession::releaseShared();     // release the shared context and queue before exiting
+
+    CLSimpleWrapper::freeHostBuffer(matrixA);
+    CLSimpleWrapper::freeHostBuffer(matrixB);
+    CLSimpleWrapper::freeHostBuffer(matrixBTrans);
+    CLSimpleWrapper::freeHostBuffer(matrixResult);
+
 }
@@ -0,0 +1,106 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CLSimpleWrapper.h"
+
+// currently simplify platform and device selection using this
+#define PLATFORM_ID -1
+#define DEVICE_ID -1
+
+#define THREAD_COUNT 4
+#define REQUEST_COUNT 64     // independent requests per thread
+#define VECTOR_SIZE (1024 * 1024)
+
+std::string ClSrcVectorAdd = R"CLC(
+__kernel void vectorAdd(__global const int* a,
+    __global const int* b,
+    __global int* c)
+{
+    size_t i = get_global_id(0);
+    c[i] = a[i] + b[i];
+}
+)CLC";
+
+// every thread drives the device with its own clone: own kernel instance, arguments and queue of the session pool.
+void runRequests(CLSimpleWrapper& cl_wrapper, int thread_index, std::atomic<size_t>& error_count)
+{
+    std::vector<int> a(VECTOR_SIZE);
+    std::vector<int> b(VECTOR_SIZE);
+    std::vector<int> c(VECTOR_SIZE);
+
+    for ( int request = 0; request < REQUEST_COUNT; request++ )
+    {
+        for ( size_t i = 0; i < a.size(); i++ )
+        {
+            a[i] = (int)i;
+            b[i] = thread_index * REQUEST_COUNT + request;
+        }
+
+        cl_wrapper.setKernelBufferArg(0, a.data(), a.size() * sizeof(int));
+        cl_wrapper.setKernelBufferArg(1, b.data(), b.size() * sizeof(int));
+        cl_wrapper.setKernelBufferArg(2, nullptr, c.size() * sizeof(int));
+
+        size_t global_item_size = VECTOR_SIZE;
+        cl_wrapper.executeKernel(1, &global_item_size, NULL);
+        cl_wrapper.readBuffer(c.data(), 2, c.size() * sizeof(int));
+
+        for ( size_t i = 0; i < c.size(); i++ )
+        {
+            if ( c[i] != a[i] + b[i] )
+            {
+                error_count++;
+                break;
+            }
+        }
+    }
+}
+
+int main()
+{
+    std::shared_ptr<CLSession> session = CLSession::create(PLATFORM_ID, DEVICE_ID);
+    if ( !session->isValid() )
+    {
+        return 1;
+    }
+    std::cout << "Device: " << CLSession::getDeviceName(session->getDevice()) << "\n";
+
+    // one queue per thread, out-of-order when the device supports it
+    if ( CL_SUCCESS != session->createQueuePool(THREAD_COUNT, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) )
+    {
+        std::cout << "Out-of-order queues not supported, using in-order queues\n";
+        session->createQueuePool(THREAD_COUNT);
+    }
+
+    CLSimpleWrapper cl_wrapper(session);
+    cl_int error = cl_wrapper.createCLKernel(ClSrcVectorAdd, "vectorAdd");
+    CLSimpleWrapper::checkCLError(error, "Build Program Failed");
+
+    std::vector<std::unique_ptr<CLSimpleWrapper> > workers;
+    for ( int i = 0; i < THREAD_COUNT; i++ )
+    {
+        workers.push_back(cl_wrapper.clone());
+    }
+
+    std::atomic<size_t> error_count(0);
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for ( int i = 0; i < THREAD_COUNT; i++ )
+    {
+        threads.emplace_back(runRequests, std::ref(*workers[i]), i, std::ref(error_count));
+    }
+    for ( std::thread& thread : threads )
+    {
+        thread.join();
+    }
+    auto finish = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = finish - start;
+
+    std::cout << THREAD_COUNT * REQUEST_COUNT << " requests on " << THREAD_COUNT << " threads: "
+        << (error_count == 0 ? "PASS" : "FAIL") << ", elapsed time: " << elapsed.count() << " s\n";
+    return error_count == 0 ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "CLSimpleWrapper.h"
+
+// currently simplify platform and device selection using this
+#define PLATFORM_ID -1
+#define DEVICE_ID -1
+
+// 256 MB of input, processed 4 MB at a time: the device never holds more than BUFFER_COUNT chunks
+#define ELEMENT_COUNT (64 * 1024 * 1024)
+#define CHUNK_SIZE (1024 * 1024)
+#define BUFFER_COUNT 3
+
+// y = a * x + b, one work item per element of the chunk
+std::string ClSrcScale = R"CLC(
+__kernel void scaleOffset(__global const float* x,
+    __global float* y,
+    const float a,
+    const float b)
+{
+    size_t i = get_global_id(0);
+    y[i] = a * x[i] + b;
+}
+)CLC";
+
+int main()
+{
+    std::shared_ptr<CLSession> session = CLSession::create(PLATFORM_ID, DEVICE_ID);
+    if ( !session->isValid() )
+    {
+        return 1;
+    }
+    std::cout << "Device: " << CLSession::getDeviceName(session->getDevice()) << "\n";
+
+    // the program is compiled on a worker thread while the input is generated
+    CLSimpleWrapper cl_wrapper(session);
+    CLBuildHandle build = cl_wrapper.createCLKernelAsync(ClSrcScale, "scaleOffset");
+
+    std::vector<float> input(ELEMENT_COUNT);
+    for ( size_t i = 0; i < input.size(); i++ )
+    {
+        input[i] = (float)(i % 1000);
+    }
+
+    CLSimpleWrapper::checkCLError(build.wait(), "Build Program Failed");
+
+    float a = 2.0f;
+    float b = 1.0f;
+    cl_wrapper.setKernelArg(2, &a, sizeof(float));
+    cl_wrapper.setKernelArg(3, &b, sizeof(float));
+
+    // each completed chunk is checked as soon as it is read back, while the next ones are still processed
+    size_t error_count = 0;
+    size_t chunk_count = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    cl_wrapper.executeKernelStream(input.data(), input.size(), sizeof(float), sizeof(float), CHUNK_SIZE, 0, 1,
+        [&](size_t /*chunk_index*/, size_t first, size_t count, const void* output)
+        {
+            const float* y = (const float*)output;
+            for ( size_t i = 0; i < count; i++ )
+            {
+                if ( y[i] != a * input[first + i] + b )
+                {
+                    error_count++;
+                }
+            }
+            chunk_count++;
+        },
+        BUFFER_COUNT);
+    auto finish = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = finish - start;
+
+    std::cout << chunk_count << " chunks, " << (error_count == 0 ? "PASS" : "FAIL")
+        << ", elapsed time: " << elapsed.count() << " s\n";
+    return error_count == 0 ? 0 : 1;
+}
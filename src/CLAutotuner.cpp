@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "CLAutotuner.h"
+#include "CLProgramCache.h"
+
+
+CLAutotuner::CLAutotuner()
+{
+
+}
+
+void CLAutotuner::setTuningFile(std::string path)
+{
+    m_tuningFile = path;
+
+    std::ifstream ifs(path);
+    std::string line;
+    while ( std::getline(ifs, line) )
+    {
+        std::istringstream iss(line);
+        std::string key;
+        std::string value;
+        if ( !(iss >> key) )
+        {
+            continue;
+        }
+
+        std::vector<size_t> local;
+        while ( iss >> value )
+        {
+            if ( value != "-" )
+            {
+                local.push_back(std::stoul(value));
+            }
+        }
+        m_entries[key] = local;
+    }
+}
+
+std::string CLAutotuner::makeKey(const std::string& kernel_name, const std::string& device_signature,
+    size_t workSize, const size_t* globalItemSize)
+{
+    // kernel@device/shape, the device part is hashed: names contain spaces
+    std::string key = kernel_name + "@" + CLProgramCache::hash(device_signature) + "/";
+    for ( size_t dim = 0; dim < workSize; dim++ )
+    {
+        key += (dim > 0 ? "x" : "") + std::to_string(globalItemSize[dim]);
+    }
+    return key;
+}
+
+bool CLAutotuner::find(const std::string& key, std::vector<size_t>& localItemSize) const
+{
+    auto entry = m_entries.find(key);
+    if ( entry == m_entries.end() )
+    {
+        return false;
+    }
+
+    localItemSize = entry->second;
+    return true;
+}
+
+void CLAutotuner::store(const std::string& key, const std::vector<size_t>& localItemSize)
+{
+    m_entries[key] = localItemSize;
+    save();
+}
+
+std::vector<std::vector<size_t> > CLAutotuner::getCandidates(size_t workSize, const size_t* globalItemSize,
+    size_t max_work_group_size, size_t preferred_multiple, const size_t* max_work_item_sizes,
+    size_t max_candidates)
+{
+    // divisors of the global size for every dimension, OpenCL 1.2 requires global % local == 0
+    std::vector<std::vector<size_t> > divisors(workSize);
+    for ( size_t dim = 0; dim < workSize; dim++ )
+    {
+        size_t limit = std::min(max_work_group_size, max_work_item_sizes[dim]);
+        for ( size_t d = 1; d <= limit && d <= globalItemSize[dim]; d++ )
+        {
+            if ( 0 == globalItemSize[dim] % d )
+            {
+                divisors[dim].push_back(d);
+            }
+        }
+    }
+
+    std::vector<std::vector<size_t> > candidates(1, std::vector<size_t>());
+    for ( size_t dim = 0; dim < workSize; dim++ )
+    {
+        std::vector<std::vector<size_t> > expanded;
+        for ( const std::vector<size_t>& candidate : candidates )
+        {
+            size_t group_size = 1;
+            for ( size_t size : candidate )
+            {
+                group_size *= size;
+            }
+
+            for ( size_t d : divisors[dim] )
+            {
+                if ( group_size * d <= max_work_group_size )
+                {
+                    std::vector<size_t> next = candidate;
+                    next.push_back(d);
+                    expanded.push_back(next);
+                }
+            }
+        }
+        candidates.swap(expanded);
+    }
+
+    // preferred multiple first, then larger work groups: tiny work groups are rarely the fastest.
+    auto group_size = [](const std::vector<size_t>& local)
+    {
+        size_t size = 1;
+        for ( size_t s : local )
+        {
+            size *= s;
+        }
+        return size;
+    };
+    std::stable_sort(candidates.begin(), candidates.end(),
+        [&](const std::vector<size_t>& a, const std::vector<size_t>& b)
+        {
+            bool a_preferred = (0 == group_size(a) % preferred_multiple);
+            bool b_preferred = (0 == group_size(b) % preferred_multiple);
+            if ( a_preferred != b_preferred )
+            {
+                return a_preferred;
+            }
+            return group_size(a) > group_size(b);
+        });
+
+    if ( candidates.size() > max_candidates )
+    {
+        candidates.resize(max_candidates);
+    }
+    return candidates;
+}
+
+bool CLAutotuner::save() const
+{
+    if ( m_tuningFile.empty() )
+    {
+        return false;
+    }
+
+    std::ofstream ofs(m_tuningFile, std::ios::trunc);
+    if ( !ofs )
+    {
+        std::cerr << "Unable to write tuning file: " << m_tuningFile << '\n';
+        return false;
+    }
+
+    for ( const auto& entry : m_entries )
+    {
+        ofs << entry.first;
+        if ( entry.second.empty() )
+        {
+            ofs << " -";
+        }
+        for ( size_t size : entry.second )
+        {
+            ofs << " " << size;
+        }
+        ofs << '\n';
+    }
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+
+#include "CLConfig.h"
+
+// Best local work size per kernel / device / global size, persisted into a tuning file.
+//  The file is a plain text file, one entry per line: "<key> <local size>..." where "-" stands for
+//  the driver default (NULL local size), so that it can be reviewed and edited by hand.
+class CLAutotuner
+{
+public:
+    CLAutotuner();
+
+    // load the existing entries of the file, and write the new ones into it. empty path keeps them in memory only.
+    void setTuningFile(std::string path);
+
+    static std::string makeKey(const std::string& kernel_name, const std::string& device_signature,
+        size_t workSize, const size_t* globalItemSize);
+
+    // tuned local size of the key, empty local size means driver default.
+    bool find(const std::string& key, std::vector<size_t>& localItemSize) const;
+
+    void store(const std::string& key, const std::vector<size_t>& localItemSize);
+
+    // local sizes worth trying: each dimension divides the global size and fits the device limits,
+    //  work group size does not exceed max_work_group_size. Multiples of the preferred multiple come first,
+    //  at most max_candidates are returned.
+    static std::vector<std::vector<size_t> > getCandidates(size_t workSize, const size_t* globalItemSize,
+        size_t max_work_group_size, size_t preferred_multiple, const size_t* max_work_item_sizes,
+        size_t max_candidates = 32);
+
+private:
+    bool save() const;
+
+    std::string m_tuningFile;
+    std::map<std::string, std::vector<size_t> > m_entries;
+};
@@ -0,0 +1,69 @@
+#include "CLBatchJob.h"
+
+
+CLBatchJob::CLBatchJob(std::string kernel_name)
+    : m_kernelName(kernel_name),
+    m_workSize(0),
+    m_globalItemSize{ 0, 0, 0 },
+    m_localItemSize{ 0, 0, 0 },
+    m_hasLocalItemSize(false)
+{
+
+}
+
+void CLBatchJob::setArg(unsigned int index, const void* value, size_t len)
+{
+    const char* bytes = static_cast<const char*>(value);
+    m_args.push_back({ index, std::vector<char>(bytes, bytes + len) });
+}
+
+void CLBatchJob::setInput(unsigned int index, const void* data, size_t len)
+{
+    m_buffers.push_back({ index, data, nullptr, len });
+}
+
+void CLBatchJob::setOutput(unsigned int index, void* outData, size_t len)
+{
+    m_buffers.push_back({ index, nullptr, outData, len });
+}
+
+void CLBatchJob::setWorkSize(size_t workSize, const size_t* globalItemSize, const size_t* localItemSize)
+{
+    m_workSize = workSize;
+    m_hasLocalItemSize = (NULL != localItemSize);
+    for ( size_t dim = 0; dim < workSize && dim < 3; dim++ )
+    {
+        m_globalItemSize[dim] = globalItemSize[dim];
+        m_localItemSize[dim] = m_hasLocalItemSize ? localItemSize[dim] : 0;
+    }
+}
+
+const std::string& CLBatchJob::getKernelName() const
+{
+    return m_kernelName;
+}
+
+const std::vector<CLBatchJob::Arg>& CLBatchJob::getArgs() const
+{
+    return m_args;
+}
+
+const std::vector<CLBatchJob::Buffer>& CLBatchJob::getBuffers() const
+{
+    return m_buffers;
+}
+
+size_t CLBatchJob::getWorkSize() const
+{
+    return m_workSize;
+}
+
+const size_t* CLBatchJob::getGlobalItemSize() const
+{
+    return m_globalItemSize;
+}
+
+const size_t* CLBatchJob::getLocalItemSize() const
+{
+    return m_hasLocalItemSize ? m_localItemSize : NULL;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include "CLConfig.h"
+
+// One launch of CLSimpleWrapper::executeBatch(): kernel, arguments, global size and buffers.
+//  arguments not set by the job keep their current value on the kernel, i.e. a buffer shared by every job.
+class CLBatchJob
+{
+public:
+    struct Arg
+    {
+        unsigned int index;
+        std::vector<char> value;
+    };
+
+    struct Buffer
+    {
+        unsigned int index;
+        const void* input;      // nullptr for an output
+        void* output;           // nullptr for an input
+        size_t len;
+    };
+
+    // empty kernel name: current kernel of the wrapper.
+    explicit CLBatchJob(std::string kernel_name = "");
+
+    // scalar argument, the value is copied.
+    void setArg(unsigned int index, const void* value, size_t len);
+
+    // packed into the single upload of the batch, data must stay valid until executeBatch() returns.
+    void setInput(unsigned int index, const void* data, size_t len);
+
+    // packed into the single download of the batch, copied into outData when executeBatch() returns.
+    void setOutput(unsigned int index, void* outData, size_t len);
+
+    // localItemSize NULL: driver default.
+    void setWorkSize(size_t workSize, const size_t* globalItemSize, const size_t* localItemSize = NULL);
+
+    const std::string& getKernelName() const;
+
+    const std::vector<Arg>& getArgs() const;
+
+    const std::vector<Buffer>& getBuffers() const;
+
+    size_t getWorkSize() const;
+
+    const size_t* getGlobalItemSize() const;
+
+    const size_t* getLocalItemSize() const;     // NULL when not set
+
+private:
+    std::string m_kernelName;
+    std::vector<Arg> m_args;
+    std::vector<Buffer> m_buffers;
+    size_t m_workSize;
+    size_t m_globalItemSize[3];
+    size_t m_localItemSize[3];
+    bool m_hasLocalItemSize;
+};
@@ -0,0 +1,133 @@
+#include "CLBufferPool.h"
+
+
+CLBufferPool::CLBufferPool()
+    : m_context(nullptr),
+    m_allocatedBytes(0),
+    m_inUseBytes(0),
+    m_highWaterMark(0),
+    m_acquireCount(0),
+    m_createCount(0)
+{
+
+}
+
+CLBufferPool::~CLBufferPool()
+{
+    releaseAll();
+}
+
+void CLBufferPool::setContext(cl_context context)
+{
+    m_context = context;
+}
+
+cl_mem CLBufferPool::acquire(size_t len, cl_mem_flags flags, cl_int* error)
+{
+    BucketKey key(flags, getBucketSize(len));
+    cl_mem buffer = nullptr;
+
+    m_acquireCount++;
+
+    std::vector<cl_mem>& free_buffers = m_freeBuffers[key];
+    if ( !free_buffers.empty() )
+    {
+        buffer = free_buffers.back();
+        free_buffers.pop_back();
+        *error = CL_SUCCESS;
+    }
+    else
+    {
+        buffer = clCreateBuffer(m_context, flags, key.second, NULL, error);
+        if ( *error != CL_SUCCESS )
+        {
+            return nullptr;
+        }
+
+        m_ownedBuffers[buffer] = key;
+        m_allocatedBytes += key.second;
+        m_createCount++;
+    }
+
+    m_inUseBytes += key.second;
+    if ( m_inUseBytes > m_highWaterMark )
+    {
+        m_highWaterMark = m_inUseBytes;
+    }
+
+    return buffer;
+}
+
+bool CLBufferPool::release(cl_mem buffer)
+{
+    auto owned = m_ownedBuffers.find(buffer);
+    if ( owned == m_ownedBuffers.end() )
+    {
+        return false;
+    }
+
+    m_inUseBytes -= owned->second.second;
+    m_freeBuffers[owned->second].push_back(buffer);
+    return true;
+}
+
+void CLBufferPool::trim()
+{
+    for ( auto& bucket : m_freeBuffers )
+    {
+        for ( cl_mem buffer : bucket.second )
+        {
+            clReleaseMemObject(buffer);
+            m_ownedBuffers.erase(buffer);
+            m_allocatedBytes -= bucket.first.second;
+        }
+    }
+    m_freeBuffers.clear();
+}
+
+void CLBufferPool::releaseAll()
+{
+    for ( auto& owned : m_ownedBuffers )
+    {
+        clReleaseMemObject(owned.first);
+    }
+    m_ownedBuffers.clear();
+    m_freeBuffers.clear();
+
+    m_allocatedBytes = 0;
+    m_inUseBytes = 0;
+}
+
+size_t CLBufferPool::getHighWaterMark() const
+{
+    return m_highWaterMark;
+}
+
+size_t CLBufferPool::getAllocatedBytes() const
+{
+    return m_allocatedBytes;
+}
+
+double CLBufferPool::getReuseRate() const
+{
+    if ( 0 == m_acquireCount )
+    {
+        return 0.0;
+    }
+    return double(m_acquireCount - m_createCount) / double(m_acquireCount);
+}
+
+size_t CLBufferPool::getCreateCount() const
+{
+    return m_createCount;
+}
+
+size_t CLBufferPool::getBucketSize(size_t len)
+{
+    size_t bucket = 256;
+    while ( bucket < len )
+    {
+        bucket <<= 1;
+    }
+    return bucket;
+}
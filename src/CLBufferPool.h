@@ -0,0 +1,60 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <utility>
+
+#include "CLConfig.h"
+
+// Size-bucketed pool of device buffers.
+//  Requested sizes are rounded up to the next power of two (minimum 256 bytes), and released buffers
+//  are kept per (flags, bucket) to be handed out again, so repeated launches with the same shapes
+//  do not call clCreateBuffer() at all.
+class CLBufferPool
+{
+public:
+    CLBufferPool();
+    ~CLBufferPool();
+
+    // must be set before acquire(), buffers are created within this context.
+    void setContext(cl_context context);
+
+    // get a buffer of at least len bytes, error is set when a new buffer can't be created.
+    cl_mem acquire(size_t len, cl_mem_flags flags, cl_int* error);
+
+    // return the buffer into the pool, false if the buffer is not owned by this pool.
+    bool release(cl_mem buffer);
+
+    // release the free buffers back to the device, buffers in use are kept.
+    void trim();
+
+    // release every buffer, including those still in use. Call before releasing the context.
+    void releaseAll();
+
+    // peak number of bytes in use at the same time, use it to size the pool in production.
+    size_t getHighWaterMark() const;
+
+    // number of bytes currently allocated on the device (in use + free).
+    size_t getAllocatedBytes() const;
+
+    // ratio of acquire() served without clCreateBuffer(), 0 when nothing was acquired yet.
+    double getReuseRate() const;
+
+    size_t getCreateCount() const;
+
+private:
+    typedef std::pair<cl_mem_flags, size_t> BucketKey;  // (flags, bucket size)
+
+    static size_t getBucketSize(size_t len);
+
+    cl_context m_context;
+
+    std::map<BucketKey, std::vector<cl_mem> > m_freeBuffers;
+    std::map<cl_mem, BucketKey> m_ownedBuffers;  // every buffer created by the pool
+
+    size_t m_allocatedBytes;
+    size_t m_inUseBytes;
+    size_t m_highWaterMark;
+    size_t m_acquireCount;
+    size_t m_createCount;
+};
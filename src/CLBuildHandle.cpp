@@ -0,0 +1,37 @@
+#include <chrono>
+
+#include "CLBuildHandle.h"
+
+
+CLBuildHandle::CLBuildHandle()
+{
+
+}
+
+CLBuildHandle::CLBuildHandle(std::shared_future<cl_int> build)
+    : m_build(build)
+{
+
+}
+
+CLBuildHandle::CLBuildHandle(cl_int error)
+{
+    std::promise<cl_int> done;
+    done.set_value(error);
+    m_build = done.get_future().share();
+}
+
+bool CLBuildHandle::isValid() const
+{
+    return m_build.valid();
+}
+
+bool CLBuildHandle::isReady() const
+{
+    return m_build.valid() && std::future_status::ready == m_build.wait_for(std::chrono::seconds(0));
+}
+
+cl_int CLBuildHandle::wait() const
+{
+    return m_build.valid() ? m_build.get() : CL_INVALID_VALUE;
+}
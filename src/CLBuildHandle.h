@@ -0,0 +1,36 @@
+#pragma once
+
+#include <future>
+#include <string>
+
+#include "CLConfig.h"
+
+// Program build running in the background, returned by CLSimpleWrapper::createCLKernelAsync() and
+//  CLSimpleWrapper::prebuildCLKernels(). Copies share the same build.
+class CLBuildHandle
+{
+public:
+    CLBuildHandle();
+
+    explicit CLBuildHandle(std::shared_future<cl_int> build);
+
+    // build already done (i.e. found in the session or the program cache) with error.
+    explicit CLBuildHandle(cl_int error);
+
+    bool isValid() const;
+
+    bool isReady() const;
+
+    // block until the build is done, CL_SUCCESS or the clBuildProgram() error.
+    cl_int wait() const;
+
+private:
+    std::shared_future<cl_int> m_build;
+};
+
+// source and build options of a program to build ahead, see CLSimpleWrapper::prebuildCLKernels().
+struct CLProgramSource
+{
+    std::string source;
+    std::string build_options;
+};
@@ -0,0 +1,221 @@
+#include <algorithm>
+
+#include "CLCommandGraph.h"
+
+const size_t CLCommandGraph::NO_BUFFER;
+
+CLCommandGraph::CLCommandGraph()
+{
+}
+
+CLCommandGraph::~CLCommandGraph()
+{
+    clear();
+}
+
+CLCommandGraph::CLCommandGraph(const CLCommandGraph& other) :
+    m_nodes(other.m_nodes),
+    m_bufferStates(other.m_bufferStates)
+{
+    retainKernels();
+}
+
+CLCommandGraph& CLCommandGraph::operator=(const CLCommandGraph& other)
+{
+    if ( this != &other )
+    {
+        clear();
+        m_nodes = other.m_nodes;
+        m_bufferStates = other.m_bufferStates;
+        retainKernels();
+    }
+    return *this;
+}
+
+void CLCommandGraph::addWrite(size_t buffer_index, const void* data, size_t len, size_t offset)
+{
+    Node node = Node();
+    node.type = NodeType::Write;
+    node.buffer_index = buffer_index;
+    node.offset = offset;
+    node.len = len;
+    node.host_ptr = const_cast<void*>(data);
+    addNode(node);
+}
+
+void CLCommandGraph::addWriteRect(size_t buffer_index, const void* data, const size_t* buffer_origin,
+    const size_t* host_origin, const size_t* region, size_t buffer_row_pitch, size_t host_row_pitch)
+{
+    Node node = Node();
+    node.type = NodeType::WriteRect;
+    node.buffer_index = buffer_index;
+    std::copy(buffer_origin, buffer_origin + 3, node.buffer_origin);
+    std::copy(host_origin, host_origin + 3, node.host_origin);
+    std::copy(region, region + 3, node.region);
+    node.buffer_row_pitch = buffer_row_pitch;
+    node.host_row_pitch = host_row_pitch;
+    node.host_ptr = const_cast<void*>(data);
+    addNode(node);
+}
+
+void CLCommandGraph::addKernel(cl_kernel kernel, const std::string& kernel_name, const std::vector<KernelArg>& args,
+    size_t work_dim, const size_t* global_size, const size_t* local_size)
+{
+    Node node = Node();
+    node.type = NodeType::Kernel;
+    node.buffer_index = NO_BUFFER;
+    node.kernel = kernel;
+    clRetainKernel(kernel);     // the wrapper releases it when a newer program has a kernel of the same name
+    node.kernel_name = kernel_name;
+    node.args = args;
+    node.global_size.assign(global_size, global_size + work_dim);
+    if ( nullptr != local_size )
+    {
+        node.local_size.assign(local_size, local_size + work_dim);
+    }
+    addNode(node);
+}
+
+void CLCommandGraph::addRead(size_t buffer_index, void* data, size_t len, size_t offset)
+{
+    Node node = Node();
+    node.type = NodeType::Read;
+    node.buffer_index = buffer_index;
+    node.offset = offset;
+    node.len = len;
+    node.host_ptr = data;
+    addNode(node);
+}
+
+void CLCommandGraph::patchHostPointer(const void* recorded, void* replacement)
+{
+    for ( Node& node : m_nodes )
+    {
+        if ( node.host_ptr == recorded )
+        {
+            node.host_ptr = replacement;
+        }
+    }
+}
+
+void CLCommandGraph::patchBuffer(size_t recorded_index, size_t buffer_index)
+{
+    std::vector<Node> nodes;
+    nodes.swap(m_nodes);
+    m_bufferStates.clear();
+
+    // two buffers may become one: the dependencies are derived again
+    for ( Node& node : nodes )
+    {
+        if ( node.buffer_index == recorded_index )
+        {
+            node.buffer_index = buffer_index;
+        }
+        for ( KernelArg& arg : node.args )
+        {
+            if ( arg.buffer_index == recorded_index )
+            {
+                arg.buffer_index = buffer_index;
+            }
+        }
+        addNode(node);
+    }
+}
+
+const std::vector<CLCommandGraph::Node>& CLCommandGraph::getNodes() const
+{
+    return m_nodes;
+}
+
+bool CLCommandGraph::isEmpty() const
+{
+    return m_nodes.empty();
+}
+
+void CLCommandGraph::clear()
+{
+    for ( Node& node : m_nodes )
+    {
+        if ( nullptr != node.kernel )
+        {
+            clReleaseKernel(node.kernel);
+        }
+    }
+    m_nodes.clear();
+    m_bufferStates.clear();
+}
+
+std::vector<size_t> CLCommandGraph::getBuffers(const Node& node, bool& is_write)
+{
+    std::vector<size_t> buffers;
+    is_write = (NodeType::Read != node.type);   // arguments of a kernel may be written, unknown which ones
+    if ( NO_BUFFER != node.buffer_index )
+    {
+        buffers.push_back(node.buffer_index);
+    }
+    for ( const KernelArg& arg : node.args )
+    {
+        if ( NO_BUFFER != arg.buffer_index )
+        {
+            buffers.push_back(arg.buffer_index);
+        }
+    }
+    return buffers;
+}
+
+void CLCommandGraph::addNode(Node& node)
+{
+    size_t node_index = m_nodes.size();
+    bool is_write = false;
+    node.dependencies.clear();
+
+    for ( size_t buffer : getBuffers(node, is_write) )
+    {
+        auto state = m_bufferStates.find(buffer);
+        if ( state == m_bufferStates.end() )
+        {
+            if ( is_write )
+            {
+                m_bufferStates[buffer] = BufferState{ node_index, std::vector<size_t>() };
+            }
+            else
+            {
+                m_bufferStates[buffer] = BufferState{ NO_BUFFER, std::vector<size_t>(1, node_index) };
+            }
+            continue;
+        }
+
+        // read after write, and write after read or write
+        if ( NO_BUFFER != state->second.last_writer )
+        {
+            node.dependencies.push_back(state->second.last_writer);
+        }
+        if ( is_write )
+        {
+            node.dependencies.insert(node.dependencies.end(), state->second.readers.begin(), state->second.readers.end());
+            state->second.last_writer = node_index;
+            state->second.readers.clear();
+        }
+        else
+        {
+            state->second.readers.push_back(node_index);
+        }
+    }
+
+    std::sort(node.dependencies.begin(), node.dependencies.end());
+    node.dependencies.erase(std::unique(node.dependencies.begin(), node.dependencies.end()), node.dependencies.end());
+    node.dependencies.erase(std::remove(node.dependencies.begin(), node.dependencies.end(), node_index),
+        node.dependencies.end());
+    m_nodes.push_back(node);
+}
+
+void CLCommandGraph::retainKernels()
+{
+    for ( Node& node : m_nodes )
+    {
+        if ( nullptr != node.kernel )
+        {
+            clRetainKernel(node.kernel);
+        }
+    }
+}
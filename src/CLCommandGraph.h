@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+
+#include "CLConfig.h"
+
+// Writes, kernel launches and reads captured by CLSimpleWrapper::beginRecording(), replayed with a single
+//  CLSimpleWrapper::replay() call. Buffers are referred to by the wrapper buffer index (kernel argument index
+//  of setKernelBufferArg()), and resolved at replay time, so a graph survives the re-creation of its buffers.
+//  The dependencies between the nodes are derived from the buffers they use: on an out-of-order queue,
+//  independent nodes run concurrently. The graph holds a reference on its kernels, so a newer program replacing
+//  them in the recording wrapper doesn't free them: replay the graph on the recording wrapper.
+class CLCommandGraph
+{
+public:
+    enum class NodeType
+    {
+        Write,
+        WriteRect,
+        Kernel,
+        Read
+    };
+
+    struct KernelArg
+    {
+        unsigned int index;
+        std::vector<char> value;
+        size_t buffer_index;    // wrapper buffer bound to the argument, NO_BUFFER for other arguments
+    };
+
+    struct Node
+    {
+        NodeType type;
+
+        // write and read: host data written into / read from len bytes at offset of the buffer
+        size_t buffer_index;
+        size_t offset;
+        size_t len;
+        void* host_ptr;
+
+        // write rect: region at the origins, see CLSimpleWrapper::writeBufferRect()
+        size_t buffer_origin[3];
+        size_t host_origin[3];
+        size_t region[3];
+        size_t buffer_row_pitch;
+        size_t host_row_pitch;
+
+        // kernel launch: every argument value set on the kernel when it was recorded
+        cl_kernel kernel;       // retained by the graph
+        std::string kernel_name;
+        std::vector<KernelArg> args;
+        std::vector<size_t> global_size;
+        std::vector<size_t> local_size;     // empty: driver default
+
+        std::vector<size_t> dependencies;   // earlier nodes using the same buffers
+    };
+
+    static const size_t NO_BUFFER = (size_t)-1;
+
+    CLCommandGraph();
+    ~CLCommandGraph();
+
+    CLCommandGraph(const CLCommandGraph& other);
+    CLCommandGraph& operator=(const CLCommandGraph& other);
+
+    void addWrite(size_t buffer_index, const void* data, size_t len, size_t offset);
+
+    void addWriteRect(size_t buffer_index, const void* data, const size_t* buffer_origin, const size_t* host_origin,
+        const size_t* region, size_t buffer_row_pitch, size_t host_row_pitch);
+
+    void addKernel(cl_kernel kernel, const std::string& kernel_name, const std::vector<KernelArg>& args,
+        size_t work_dim, const size_t* global_size, const size_t* local_size);
+
+    void addRead(size_t buffer_index, void* data, size_t len, size_t offset);
+
+    // replace the host array of the recorded writes and reads, i.e. the input and output of the next iteration.
+    void patchHostPointer(const void* recorded, void* replacement);
+
+    // use the wrapper buffer of buffer_index wherever the buffer of recorded_index is used (writes, reads, arguments).
+    void patchBuffer(size_t recorded_index, size_t buffer_index);
+
+    const std::vector<Node>& getNodes() const;
+
+    bool isEmpty() const;
+
+    void clear();
+
+private:
+    // buffers used by the node, and if the node may write them
+    static std::vector<size_t> getBuffers(const Node& node, bool& is_write);
+
+    // the last writer of each buffer, and every reader since
+    struct BufferState
+    {
+        size_t last_writer;
+        std::vector<size_t> readers;
+    };
+
+    void addNode(Node& node);
+
+    void retainKernels();
+
+    std::vector<Node> m_nodes;
+    std::map<size_t, BufferState> m_bufferStates;
+};
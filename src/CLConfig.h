@@ -0,0 +1,11 @@
+#pragma once
+
+#define CL_TARGET_OPENCL_VERSION 120
+//#define _CL_CPP   // not using OpenCL C++ binding for now
+
+#include <CL/opencl.h>
+#ifdef _CL_CPP
+#define CL_HPP_TARGET_OPENCL_VERSION 120
+#define CL_HPP_MINIMUM_OPENCL_VERSION 120
+#include "CL/opencl.hpp"	// if using C++ binding
+#endif
@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "CLDeviceSelector.h"
+#include "CLSimpleWrapper.h"
+
+// calibration sizes: about 1 GFLOP and 64 MB of traffic per run
+#define CALIBRATION_ITEMS (256 * 1024)
+#define CALIBRATION_ITERATIONS 256
+#define CALIBRATION_COPY_BYTES (32 * 1024 * 1024)
+#define CALIBRATION_RUNS 3
+
+// 8 independent mad() chains per work item, so that the arithmetic units are not latency bound.
+static const std::string ClSrcCalibration = R"CLC(
+__kernel void calibrateCompute(__global float* out, const float a, const float b)
+{
+    float x0 = (float)get_global_id(0);
+    float x1 = x0 + 1.0f;
+    float x2 = x0 + 2.0f;
+    float x3 = x0 + 3.0f;
+    float x4 = x0 + 4.0f;
+    float x5 = x0 + 5.0f;
+    float x6 = x0 + 6.0f;
+    float x7 = x0 + 7.0f;
+    for ( int i = 0; i < ITERATIONS; i++ )
+    {
+        x0 = mad(x0, a, b);
+        x1 = mad(x1, a, b);
+        x2 = mad(x2, a, b);
+        x3 = mad(x3, a, b);
+        x4 = mad(x4, a, b);
+        x5 = mad(x5, a, b);
+        x6 = mad(x6, a, b);
+        x7 = mad(x7, a, b);
+    }
+    out[get_global_id(0)] = x0 + x1 + x2 + x3 + x4 + x5 + x6 + x7;  // keeps the loop alive
+}
+
+__kernel void calibrateCopy(__global const float4* in, __global float4* out)
+{
+    size_t i = get_global_id(0);
+    out[i] = in[i];
+}
+)CLC";
+
+
+CLDeviceSelector::CLDeviceSelector()
+    : m_isCalibrationEnabled(false),
+    m_isProbed(false)
+{
+
+}
+
+void CLDeviceSelector::setProfileFile(std::string path)
+{
+    m_profileFile = path;
+
+    // <signature> <type> <compute units> <clock> <global mem> <local mem> <fp64> <unified> <gflops> <gbps> <name>
+    std::ifstream ifs(path);
+    std::string line;
+    while ( std::getline(ifs, line) )
+    {
+        std::istringstream iss(line);
+        CLDeviceProfile profile = CLDeviceProfile();
+        if ( !(iss >> profile.signature >> profile.type >> profile.compute_units >> profile.clock_mhz
+            >> profile.global_mem_bytes >> profile.local_mem_bytes >> profile.has_fp64 >> profile.is_unified_memory
+            >> profile.gflops >> profile.gbps) )
+        {
+            continue;
+        }
+        std::getline(iss >> std::ws, profile.name);
+        m_savedProfiles[profile.signature] = profile;
+    }
+}
+
+void CLDeviceSelector::enableCalibration(bool enable)
+{
+    m_isCalibrationEnabled = enable;
+}
+
+const std::vector<CLDeviceProfile>& CLDeviceSelector::getProfiles()
+{
+    if ( m_isProbed )
+    {
+        return m_profiles;
+    }
+    m_isProbed = true;
+
+    bool is_changed = false;
+    std::vector<cl_platform_id> platformIds = CLSession::getPlatformIds();
+    for ( size_t p = 0; p < platformIds.size(); p++ )
+    {
+        std::vector<cl_device_id> deviceIds = CLSession::getDeviceIds(platformIds[p]);
+        for ( size_t d = 0; d < deviceIds.size(); d++ )
+        {
+            std::string signature = CLProgramCache::hash(CLSession::getDeviceSignature(platformIds[p], deviceIds[d]));
+            auto saved = m_savedProfiles.find(signature);
+
+            CLDeviceProfile profile;
+            if ( saved != m_savedProfiles.end() )
+            {
+                profile = saved->second;
+                profile.platform_index = (int)p;
+                profile.device_index = (int)d;
+            }
+            else
+            {
+                profile = probe((int)p, (int)d, platformIds[p], deviceIds[d]);
+                is_changed = true;
+            }
+
+            if ( m_isCalibrationEnabled && profile.gflops <= 0.0 )
+            {
+                calibrate(profile);
+                is_changed = true;
+            }
+
+            m_savedProfiles[signature] = profile;
+            m_profiles.push_back(profile);
+        }
+    }
+
+    if ( is_changed )
+    {
+        save();
+    }
+    return m_profiles;
+}
+
+double CLDeviceSelector::getScore(const CLDeviceProfile& profile, CLWorkload workload)
+{
+    // rough single precision lanes per compute unit when not calibrated
+    double lanes = (profile.type & CL_DEVICE_TYPE_GPU) ? 32.0 : (profile.type & CL_DEVICE_TYPE_ACCELERATOR) ? 16.0 : 8.0;
+    double gflops = (profile.gflops > 0.0) ? profile.gflops :
+        2.0 * lanes * profile.compute_units * profile.clock_mhz / 1000.0;
+
+    switch ( workload )
+    {
+    case CLWorkload::Compute:
+        return gflops;
+    case CLWorkload::ComputeDouble:
+        // double precision rate is not reported, consumer GPUs run it at a fraction of the single precision rate.
+        return profile.has_fp64 ? gflops / ((profile.type & CL_DEVICE_TYPE_GPU) ? 8.0 : 2.0) : 0.0;
+    case CLWorkload::Memory:
+        if ( profile.gbps > 0.0 )
+        {
+            return profile.gbps;
+        }
+        // discrete memory is usually several times faster than the host memory
+        return profile.is_unified_memory ? 20.0 : 200.0;
+    case CLWorkload::Latency:
+        // no PCIe round-trip first, compute only breaks the tie
+        return ((profile.type & CL_DEVICE_TYPE_CPU) ? 4.0 : profile.is_unified_memory ? 2.0 : 1.0) * 1e6 + gflops;
+    }
+    return 0.0;
+}
+
+bool CLDeviceSelector::selectDevice(CLWorkload workload, CLDeviceProfile& best)
+{
+    double best_score = 0.0;
+    for ( const CLDeviceProfile& profile : getProfiles() )
+    {
+        double score = getScore(profile, workload);
+        if ( score > best_score )
+        {
+            best_score = score;
+            best = profile;
+        }
+    }
+    return best_score > 0.0;
+}
+
+std::shared_ptr<CLSession> CLDeviceSelector::createSession(CLWorkload workload, cl_command_queue_properties properties)
+{
+    CLDeviceProfile best;
+    if ( !selectDevice(workload, best) )
+    {
+        std::cerr << "No OpenCL device suitable for the workload" << '\n';
+        return CLSession::createEmpty();
+    }
+    if ( CLSession::isVerbose() )
+    {
+        std::cout << "Selected Device: " << best.name << '\n';
+    }
+    return CLSession::create(best.platform_index, best.device_index, properties);
+}
+
+CLDeviceProfile CLDeviceSelector::probe(int platform_index, int device_index, cl_platform_id platform, cl_device_id device) const
+{
+    CLDeviceProfile profile = CLDeviceProfile();
+    profile.platform_index = platform_index;
+    profile.device_index = device_index;
+    profile.name = CLSession::getDeviceName(device);
+    profile.signature = CLProgramCache::hash(CLSession::getDeviceSignature(platform, device));
+
+    cl_bool is_unified_memory = CL_FALSE;
+    clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(cl_device_type), &profile.type, nullptr);
+    clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &profile.compute_units, nullptr);
+    clGetDeviceInfo(device, CL_DEVICE_MAX_CLOCK_FREQUENCY, sizeof(cl_uint), &profile.clock_mhz, nullptr);
+    clGetDeviceInfo(device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(cl_ulong), &profile.global_mem_bytes, nullptr);
+    clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &profile.local_mem_bytes, nullptr);
+    clGetDeviceInfo(device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &is_unified_memory, nullptr);
+    profile.is_unified_memory = (CL_TRUE == is_unified_memory) || (0 != (profile.type & CL_DEVICE_TYPE_CPU));
+    profile.has_fp64 = CLSession::getDeviceInfoString(device, CL_DEVICE_EXTENSIONS).find("cl_khr_fp64") != std::string::npos;
+
+    return profile;
+}
+
+void CLDeviceSelector::calibrate(CLDeviceProfile& profile) const
+{
+    CLSimpleWrapper cl_wrapper(CLSession::create(profile.platform_index, profile.device_index));
+
+    std::string source = ClSrcCalibration;
+    std::map<std::string, std::string> defines;
+    defines["ITERATIONS"] = std::to_string(CALIBRATION_ITERATIONS);
+    if ( CL_SUCCESS != cl_wrapper.createCLKernel(source, "calibrateCompute", CLSimpleWrapper::makeBuildOptions(defines)) )
+    {
+        return;
+    }
+
+    // best of the runs after a warm up, the kernel is launched and waited like an application would
+    auto measure = [&](size_t global_item_size)
+    {
+        double best_time = -1.0;
+        for ( size_t run = 0; run <= CALIBRATION_RUNS; run++ )
+        {
+            auto start = std::chrono::steady_clock::now();
+            cl_wrapper.executeKernel(1, &global_item_size, NULL);
+            cl_wrapper.finish();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if ( run > 0 && (best_time < 0.0 || elapsed.count() < best_time) )
+            {
+                best_time = elapsed.count();
+            }
+        }
+        return best_time;
+    };
+
+    float a = 0.999f;
+    float b = 0.001f;
+    cl_wrapper.setKernelBufferArg(0, nullptr, CALIBRATION_ITEMS * sizeof(float));
+    cl_wrapper.setKernelArg(1, &a, sizeof(float));
+    cl_wrapper.setKernelArg(2, &b, sizeof(float));
+    double compute_time = measure(CALIBRATION_ITEMS);
+    profile.gflops = 2.0 * 8 * CALIBRATION_ITERATIONS * (double)CALIBRATION_ITEMS / compute_time / 1e9;
+
+    cl_wrapper.selectKernel("calibrateCopy");
+    cl_wrapper.setKernelScratchBufferArg(0, CALIBRATION_COPY_BYTES);
+    cl_wrapper.setKernelScratchBufferArg(1, CALIBRATION_COPY_BYTES);
+    double copy_time = measure(CALIBRATION_COPY_BYTES / (4 * sizeof(float)));
+    profile.gbps = 2.0 * CALIBRATION_COPY_BYTES / copy_time / 1e9;
+}
+
+bool CLDeviceSelector::save() const
+{
+    if ( m_profileFile.empty() )
+    {
+        return false;
+    }
+
+    std::ofstream ofs(m_profileFile, std::ios::trunc);
+    if ( !ofs )
+    {
+        std::cerr << "Unable to write device profile file: " << m_profileFile << '\n';
+        return false;
+    }
+
+    for ( const auto& entry : m_savedProfiles )
+    {
+        const CLDeviceProfile& profile = entry.second;
+        ofs << profile.signature << " " << profile.type << " " << profile.compute_units << " " << profile.clock_mhz
+            << " " << profile.global_mem_bytes << " " << profile.local_mem_bytes << " " << profile.has_fp64
+            << " " << profile.is_unified_memory << " " << profile.gflops << " " << profile.gbps
+            << " " << profile.name << '\n';
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+
+#include "CLConfig.h"
+#include "CLSession.h"
+
+// what the device will mostly run, selects the device property that matters.
+enum class CLWorkload
+{
+    Compute,        // single precision arithmetic throughput
+    ComputeDouble,  // double precision, only devices with cl_khr_fp64
+    Memory,         // global memory bandwidth
+    Latency         // many small launches and transfers: host unified memory first, CPU devices best
+};
+
+// capabilities of one device, with the calibration results when it was run.
+struct CLDeviceProfile
+{
+    int platform_index;
+    int device_index;
+    std::string name;
+    std::string signature;      // hash of the platform, device names and driver version, key of the profile file
+    cl_device_type type;
+    cl_uint compute_units;
+    cl_uint clock_mhz;
+    cl_ulong global_mem_bytes;
+    cl_ulong local_mem_bytes;
+    bool has_fp64;
+    bool is_unified_memory;     // CL_DEVICE_HOST_UNIFIED_MEMORY: CPU or integrated GPU
+    double gflops;              // measured single precision throughput, 0 when not calibrated
+    double gbps;                // measured copy bandwidth, 0 when not calibrated
+};
+
+// Picks the best device of every platform for a workload, instead of the first one.
+//  The device properties are queried once per process. With calibration enabled, a short arithmetic and
+//  copy kernel measures each device. The profiles are kept in a plain text file, one device per line,
+//  so that later starts skip the calibration. A driver update changes the signature and invalidates the line.
+class CLDeviceSelector
+{
+public:
+    CLDeviceSelector();
+
+    // load the profiles of the file, and write the new ones into it. empty path keeps them in memory only.
+    void setProfileFile(std::string path);
+
+    // run the calibration kernels on the devices without a cached measure (about a second per device).
+    void enableCalibration(bool enable = true);
+
+    // every device of every platform.
+    const std::vector<CLDeviceProfile>& getProfiles();
+
+    // relative score of the device for the workload, 0 when the device can't run it.
+    //  measured throughput when calibrated, estimated from the compute units, clock and device type otherwise.
+    static double getScore(const CLDeviceProfile& profile, CLWorkload workload);
+
+    // false when no device can run the workload.
+    bool selectDevice(CLWorkload workload, CLDeviceProfile& best);
+
+    // session on the selected device, CLSession::createEmpty() when there is none.
+    std::shared_ptr<CLSession> createSession(CLWorkload workload, cl_command_queue_properties properties = 0);
+
+private:
+    CLDeviceProfile probe(int platform_index, int device_index, cl_platform_id platform, cl_device_id device) const;
+
+    void calibrate(CLDeviceProfile& profile) const;
+
+    bool save() const;
+
+    std::string m_profileFile;
+    bool m_isCalibrationEnabled;
+    bool m_isProbed;
+    std::map<std::string, CLDeviceProfile> m_savedProfiles;    // by signature
+    std::vector<CLDeviceProfile> m_profiles;
+};
@@ -0,0 +1,101 @@
+#include "CLEvent.h"
+
+
+CLEvent::CLEvent()
+    : m_event(nullptr)
+{
+
+}
+
+CLEvent::CLEvent(cl_event event)
+    : m_event(event)
+{
+
+}
+
+CLEvent::CLEvent(const CLEvent& other)
+    : m_event(other.m_event)
+{
+    if ( nullptr != m_event )
+    {
+        clRetainEvent(m_event);
+    }
+}
+
+CLEvent& CLEvent::operator=(const CLEvent& other)
+{
+    if ( m_event != other.m_event )
+    {
+        if ( nullptr != other.m_event )
+        {
+            clRetainEvent(other.m_event);
+        }
+        if ( nullptr != m_event )
+        {
+            clReleaseEvent(m_event);
+        }
+        m_event = other.m_event;
+    }
+    return *this;
+}
+
+CLEvent::~CLEvent()
+{
+    if ( nullptr != m_event )
+    {
+        clReleaseEvent(m_event);
+    }
+}
+
+cl_event CLEvent::get() const
+{
+    return m_event;
+}
+
+bool CLEvent::isValid() const
+{
+    return nullptr != m_event;
+}
+
+void CLEvent::wait() const
+{
+    if ( nullptr != m_event )
+    {
+        clWaitForEvents(1, &m_event);
+    }
+}
+
+bool CLEvent::isComplete() const
+{
+    if ( nullptr == m_event )
+    {
+        return true;
+    }
+
+    cl_int status = CL_COMPLETE;
+    clGetEventInfo(m_event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(cl_int), &status, nullptr);
+    return status == CL_COMPLETE || status < 0;     // negative status: command terminated with error
+}
+
+void CLEvent::waitAll(const std::vector<CLEvent>& events)
+{
+    std::vector<cl_event> wait_list = toWaitList(events);
+    if ( !wait_list.empty() )
+    {
+        clWaitForEvents((cl_uint)wait_list.size(), wait_list.data());
+    }
+}
+
+std::vector<cl_event> CLEvent::toWaitList(const std::vector<CLEvent>& events)
+{
+    std::vector<cl_event> wait_list;
+    wait_list.reserve(events.size());
+    for ( const CLEvent& event : events )
+    {
+        if ( event.isValid() )
+        {
+            wait_list.push_back(event.get());
+        }
+    }
+    return wait_list;
+}
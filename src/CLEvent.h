@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include "CLConfig.h"
+
+// Reference counted handle of a cl_event returned by the asynchronous calls of CLSimpleWrapper.
+//  Copies share the same event (clRetainEvent), the event is released with the last copy.
+class CLEvent
+{
+public:
+    CLEvent();
+
+    explicit CLEvent(cl_event event);   // takes the ownership of event
+
+    CLEvent(const CLEvent& other);
+
+    CLEvent& operator=(const CLEvent& other);
+
+    ~CLEvent();
+
+    cl_event get() const;
+
+    bool isValid() const;
+
+    // block until the command is completed.
+    void wait() const;
+
+    bool isComplete() const;
+
+    // block until every command is completed, invalid events are ignored.
+    static void waitAll(const std::vector<CLEvent>& events);
+
+    // raw cl_event array for the event_wait_list of clEnqueue*() calls.
+    static std::vector<cl_event> toWaitList(const std::vector<CLEvent>& events);
+
+private:
+    cl_event m_event;
+};
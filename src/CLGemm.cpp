@@ -0,0 +1,462 @@
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "CLGemm.h"
+
+// tile size, work per thread (columns of C computed by each work item), transpose tile size
+#define GEMM_TS 32
+#define GEMM_WPT 8
+#define GEMM_TT 16
+
+// bounds of the share of rows given to the host by the Hybrid backend, so that both sides keep being measured
+#define GEMM_MIN_HOST_RATIO 0.05
+#define GEMM_MAX_HOST_RATIO 0.95
+
+// built once per element type with -D T=<type>, USE_FP64 enables double precision.
+//  every kernel takes (M, N, K, A, B, C) except gemmNT, which takes the transposed B first:
+//  it lets CLSimpleWrapper keep the transposed matrix in argument slot 3 (output of transposeMatrix).
+static const std::string ClSrcGemm = R"CLC(
+#ifdef USE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+#define RTS (TS / WPT)  // work items per tile row
+#define VW 4            // vector width of the tile loads
+
+__kernel void gemmNaive(const int M, const int N, const int K,
+    __global const T* A, __global const T* B, __global T* C)
+{
+    const int col = get_global_id(0);
+    const int row = get_global_id(1);
+    if ( row >= M || col >= N )
+    {
+        return;
+    }
+
+    T sum = 0;
+    for ( int k = 0; k < K; k++ )
+    {
+        sum += A[row * K + k] * B[k * N + col];
+    }
+    C[row * N + col] = sum;
+}
+
+// BT is the transpose of B (N x K)
+__kernel void gemmNT(const int M, const int N, const int K,
+    __global const T* BT, __global const T* A, __global T* C)
+{
+    const int col = get_global_id(0);
+    const int row = get_global_id(1);
+    if ( row >= M || col >= N )
+    {
+        return;
+    }
+
+    T sum = 0;
+    for ( int k = 0; k < K; k++ )
+    {
+        sum += A[row * K + k] * BT[col * K + k];
+    }
+    C[row * N + col] = sum;
+}
+
+// local size (RTS, TS), global size (ceil(N / TS) * RTS, ceil(M / TS) * TS)
+__kernel void gemmTiled(const int M, const int N, const int K,
+    __global const T* A, __global const T* B, __global T* C)
+{
+    const int lcol = get_local_id(0);
+    const int lrow = get_local_id(1);
+    const int row = get_group_id(1) * TS + lrow;
+    const int col = get_group_id(0) * TS + lcol;   // this work item computes col + w * RTS
+
+    __local T Asub[TS * TS];
+    __local T Bsub[TS * TS];
+
+    T acc[WPT];
+    for ( int w = 0; w < WPT; w++ )
+    {
+        acc[w] = 0;
+    }
+
+    const int tiles = (K + TS - 1) / TS;
+    for ( int t = 0; t < tiles; t++ )
+    {
+        for ( int w = 0; w < WPT; w++ )
+        {
+            const int tcol = lcol + w * RTS;
+            const int ka = t * TS + tcol;
+            const int kb = t * TS + lrow;
+            const int cb = get_group_id(0) * TS + tcol;
+            Asub[lrow * TS + tcol] = (row < M && ka < K) ? A[row * K + ka] : (T)0;
+            Bsub[lrow * TS + tcol] = (kb < K && cb < N) ? B[kb * N + cb] : (T)0;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for ( int k = 0; k < TS; k++ )
+        {
+            const T a = Asub[lrow * TS + k];
+            for ( int w = 0; w < WPT; w++ )
+            {
+                acc[w] += a * Bsub[k * TS + lcol + w * RTS];
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    for ( int w = 0; w < WPT; w++ )
+    {
+        const int c = col + w * RTS;
+        if ( row < M && c < N )
+        {
+            C[row * N + c] = acc[w];
+        }
+    }
+}
+
+// copy VW elements of src (rows x cols) at (srow, scol) into the tile at (r, c), zero outside of the matrix.
+void loadTileVector(__local T* tile, const int r, const int c,
+    __global const T* src, const int srow, const int scol, const int rows, const int cols)
+{
+    __local T* dst = tile + r * TS + c;
+    if ( srow < rows && scol + VW <= cols )
+    {
+        vstore4(vload4(0, src + srow * cols + scol), 0, dst);
+    }
+    else
+    {
+        for ( int i = 0; i < VW; i++ )
+        {
+            dst[i] = (srow < rows && scol + i < cols) ? src[srow * cols + scol + i] : (T)0;
+        }
+    }
+}
+
+// same work distribution as gemmTiled, the tiles are loaded with vector loads along the rows.
+__kernel void gemmTiledVector(const int M, const int N, const int K,
+    __global const T* A, __global const T* B, __global T* C)
+{
+    const int lcol = get_local_id(0);
+    const int lrow = get_local_id(1);
+    const int row = get_group_id(1) * TS + lrow;
+    const int col = get_group_id(0) * TS + lcol;
+    const int lid = lrow * RTS + lcol;
+
+    __local T Asub[TS * TS];
+    __local T Bsub[TS * TS];
+
+    T acc[WPT];
+    for ( int w = 0; w < WPT; w++ )
+    {
+        acc[w] = 0;
+    }
+
+    const int tiles = (K + TS - 1) / TS;
+    for ( int t = 0; t < tiles; t++ )
+    {
+        // TS * TS / VW vectors per tile, RTS * TS work items: WPT / VW vectors each
+        for ( int v = 0; v < WPT / VW; v++ )
+        {
+            const int id = lid + v * RTS * TS;
+            const int r = id / (TS / VW);
+            const int c = (id % (TS / VW)) * VW;
+            loadTileVector(Asub, r, c, A, get_group_id(1) * TS + r, t * TS + c, M, K);
+            loadTileVector(Bsub, r, c, B, t * TS + r, get_group_id(0) * TS + c, K, N);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for ( int k = 0; k < TS; k++ )
+        {
+            const T a = Asub[lrow * TS + k];
+            for ( int w = 0; w < WPT; w++ )
+            {
+                acc[w] += a * Bsub[k * TS + lcol + w * RTS];
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    for ( int w = 0; w < WPT; w++ )
+    {
+        const int c = col + w * RTS;
+        if ( row < M && c < N )
+        {
+            C[row * N + c] = acc[w];
+        }
+    }
+}
+
+// out (cols x rows) = transpose of in (rows x cols), local size (TT, TT)
+__kernel void transposeMatrix(const int rows, const int cols,
+    __global const T* in, __global T* out)
+{
+    __local T tile[TT][TT + 1];     // +1: no bank conflict on the transposed read
+
+    const int lx = get_local_id(0);
+    const int ly = get_local_id(1);
+    const int gx = get_group_id(0) * TT;
+    const int gy = get_group_id(1) * TT;
+
+    if ( gy + ly < rows && gx + lx < cols )
+    {
+        tile[ly][lx] = in[(gy + ly) * cols + gx + lx];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    const int orow = gx + ly;
+    const int ocol = gy + lx;
+    if ( orow < cols && ocol < rows )
+    {
+        out[orow * rows + ocol] = tile[lx][ly];
+    }
+}
+)CLC";
+
+static size_t roundUp(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+CLGemm::CLGemm(std::shared_ptr<CLSession> session)
+    : m_session(session),
+    m_isProfilingEnabled(false),
+    m_backend(Backend::Device),
+    m_hostRatio(0.5)
+{
+
+}
+
+void CLGemm::multiply(const int* a, const int* b, int* c, size_t M, size_t N, size_t K, Variant variant)
+{
+    run(a, b, c, M, N, K, variant, "int");
+}
+
+void CLGemm::multiply(const float* a, const float* b, float* c, size_t M, size_t N, size_t K, Variant variant)
+{
+    run(a, b, c, M, N, K, variant, "float");
+}
+
+void CLGemm::multiply(const double* a, const double* b, double* c, size_t M, size_t N, size_t K, Variant variant)
+{
+    run(a, b, c, M, N, K, variant, "double");
+}
+
+void CLGemm::transpose(const int* in, int* out, size_t rows, size_t cols)
+{
+    runTranspose(in, out, rows, cols, "int");
+}
+
+void CLGemm::transpose(const float* in, float* out, size_t rows, size_t cols)
+{
+    runTranspose(in, out, rows, cols, "float");
+}
+
+void CLGemm::transpose(const double* in, double* out, size_t rows, size_t cols)
+{
+    runTranspose(in, out, rows, cols, "double");
+}
+
+void CLGemm::enableProfiling(bool enable)
+{
+    m_isProfilingEnabled = enable;
+    for ( auto& wrapper : m_wrappers )
+    {
+        wrapper.second->enableProfiling(enable);
+    }
+}
+
+CLSimpleWrapper& CLGemm::getWrapper(const std::string& type_name)
+{
+    std::unique_ptr<CLSimpleWrapper>& wrapper = m_wrappers[type_name];
+    if ( !wrapper )
+    {
+        wrapper.reset(new CLSimpleWrapper(m_session));
+        wrapper->enableProfiling(m_isProfilingEnabled);
+
+        std::string build_options = "-D T=" + type_name +
+            " -D TS=" + std::to_string(GEMM_TS) +
+            " -D WPT=" + std::to_string(GEMM_WPT) +
+            " -D TT=" + std::to_string(GEMM_TT);
+        if ( type_name == "double" )
+        {
+            build_options += " -D USE_FP64";
+        }
+
+        std::string source = ClSrcGemm;
+        cl_int error = wrapper->createCLKernel(source, "gemmNaive", build_options);
+        CLSimpleWrapper::checkCLError(error, "Build GEMM Program Failed");
+    }
+    return *wrapper;
+}
+
+std::string CLGemm::getVariantName(Variant variant)
+{
+    switch ( variant )
+    {
+    case Variant::Naive:
+        return "naive";
+    case Variant::NaiveTransposed:
+        return "naive_transposed";
+    case Variant::Tiled:
+        return "tiled";
+    case Variant::TiledVector:
+        return "tiled_vector";
+    }
+    return "";
+}
+
+void CLGemm::setBackend(Backend backend)
+{
+    m_backend = backend;
+}
+
+CLGemm::Backend CLGemm::getBackend() const
+{
+    return m_session->isValid() ? m_backend : Backend::Host;
+}
+
+void CLGemm::setHostThreadCount(size_t thread_count)
+{
+    m_hostGemm.setThreadCount(thread_count);
+}
+
+double CLGemm::getHostRatio() const
+{
+    return m_hostRatio;
+}
+
+template<typename T>
+void CLGemm::run(const T* a, const T* b, T* c, size_t M, size_t N, size_t K, Variant variant, const std::string& type_name)
+{
+    switch ( getBackend() )
+    {
+    case Backend::Device:
+        runDevice(a, b, c, M, N, K, variant, type_name);
+        break;
+    case Backend::Host:
+        m_hostGemm.multiply(a, b, c, M, N, K);
+        break;
+    case Backend::Hybrid:
+        runHybrid(a, b, c, M, N, K, variant, type_name);
+        break;
+    }
+}
+
+template<typename T>
+void CLGemm::runHybrid(const T* a, const T* b, T* c, size_t M, size_t N, size_t K, Variant variant, const std::string& type_name)
+{
+    // whole tiles of rows on each side, too small to split: device only
+    if ( M < 2 * GEMM_TS )
+    {
+        runDevice(a, b, c, M, N, K, variant, type_name);
+        return;
+    }
+    size_t host_rows = (size_t)(M * m_hostRatio) / GEMM_TS * GEMM_TS;
+    host_rows = std::min(std::max(host_rows, (size_t)GEMM_TS), M / GEMM_TS * GEMM_TS - GEMM_TS);
+    size_t device_rows = M - host_rows;
+
+    // last rows of A and C on the host threads, while this thread drives the device
+    std::chrono::duration<double> host_time(0);
+    std::thread host_thread([&]()
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        m_hostGemm.multiply(a + device_rows * K, b, c + device_rows * N, host_rows, N, K);
+        host_time = std::chrono::high_resolution_clock::now() - start;
+    });
+
+    auto start = std::chrono::high_resolution_clock::now();
+    runDevice(a, b, c, device_rows, N, K, variant, type_name);
+    std::chrono::duration<double> device_time = std::chrono::high_resolution_clock::now() - start;
+    host_thread.join();
+
+    // rows per second on each side, transfers included,
+    //  blended with the previous split as in CLSimpleWrapper::updateSplitRatios()
+    if ( host_time.count() > 0.0 && device_time.count() > 0.0 )
+    {
+        double host_throughput = host_rows / host_time.count();
+        double device_throughput = device_rows / device_time.count();
+        double ratio = 0.5 * m_hostRatio + 0.5 * host_throughput / (host_throughput + device_throughput);
+        m_hostRatio = std::min(std::max(ratio, GEMM_MIN_HOST_RATIO), GEMM_MAX_HOST_RATIO);
+    }
+}
+
+template<typename T>
+void CLGemm::runDevice(const T* a, const T* b, T* c, size_t M, size_t N, size_t K, Variant variant, const std::string& type_name)
+{
+    CLSimpleWrapper& cl_wrapper = getWrapper(type_name);
+    cl_int m = (cl_int)M;
+    cl_int n = (cl_int)N;
+    cl_int k = (cl_int)K;
+
+    if ( Variant::NaiveTransposed == variant )
+    {
+        // B (K x N) -> BT (N x K) into slot 3, then gemmNT reads both operands along rows.
+        cl_wrapper.selectKernel("transposeMatrix");
+        cl_wrapper.setKernelArg(0, &k, sizeof(cl_int));
+        cl_wrapper.setKernelArg(1, &n, sizeof(cl_int));
+        cl_wrapper.setKernelBufferArg(2, (void*)b, K * N * sizeof(T));
+        cl_wrapper.setKernelScratchBufferArg(3, K * N * sizeof(T));
+
+        size_t transpose_global[2] = { roundUp(N, GEMM_TT), roundUp(K, GEMM_TT) };
+        size_t transpose_local[2] = { GEMM_TT, GEMM_TT };
+        cl_wrapper.executeKernel(2, transpose_global, transpose_local);
+
+        cl_wrapper.selectKernel("gemmNT");
+        cl_wrapper.bindKernelBufferArg(3, 3);
+        cl_wrapper.releaseKernelBufferArg(2);   // B is not needed anymore
+    }
+    else
+    {
+        cl_wrapper.selectKernel(Variant::Naive == variant ? "gemmNaive" :
+            Variant::Tiled == variant ? "gemmTiled" : "gemmTiledVector");
+        cl_wrapper.setKernelBufferArg(3, (void*)a, M * K * sizeof(T));
+    }
+
+    cl_wrapper.setKernelArg(0, &m, sizeof(cl_int));
+    cl_wrapper.setKernelArg(1, &n, sizeof(cl_int));
+    cl_wrapper.setKernelArg(2, &k, sizeof(cl_int));
+    cl_wrapper.setKernelBufferArg(4, (void*)(Variant::NaiveTransposed == variant ? a : b),
+        (Variant::NaiveTransposed == variant ? M * K : K * N) * sizeof(T));
+    cl_wrapper.setKernelBufferArg(5, nullptr, M * N * sizeof(T));
+
+    if ( Variant::Naive == variant || Variant::NaiveTransposed == variant )
+    {
+        size_t global_item_size[2] = { N, M };
+        cl_wrapper.executeKernel(2, global_item_size, NULL);
+    }
+    else
+    {
+        size_t global_item_size[2] = { roundUp(N, GEMM_TS) / GEMM_WPT, roundUp(M, GEMM_TS) };
+        size_t local_item_size[2] = { GEMM_TS / GEMM_WPT, GEMM_TS };
+        cl_wrapper.executeKernel(2, global_item_size, local_item_size);
+    }
+
+    cl_wrapper.readBuffer(c, 5, M * N * sizeof(T));
+}
+
+template<typename T>
+void CLGemm::runTranspose(const T* in, T* out, size_t rows, size_t cols, const std::string& type_name)
+{
+    if ( Backend::Host == getBackend() )
+    {
+        m_hostGemm.transpose(in, out, rows, cols);
+        return;
+    }
+
+    CLSimpleWrapper& cl_wrapper = getWrapper(type_name);
+    cl_int r = (cl_int)rows;
+    cl_int c = (cl_int)cols;
+
+    cl_wrapper.selectKernel("transposeMatrix");
+    cl_wrapper.setKernelArg(0, &r, sizeof(cl_int));
+    cl_wrapper.setKernelArg(1, &c, sizeof(cl_int));
+    cl_wrapper.setKernelBufferArg(2, (void*)in, rows * cols * sizeof(T));
+    cl_wrapper.setKernelBufferArg(3, nullptr, rows * cols * sizeof(T));
+
+    size_t global_item_size[2] = { roundUp(cols, GEMM_TT), roundUp(rows, GEMM_TT) };
+    size_t local_item_size[2] = { GEMM_TT, GEMM_TT };
+    cl_wrapper.executeKernel(2, global_item_size, local_item_size);
+
+    cl_wrapper.readBuffer(out, 3, rows * cols * sizeof(T));
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <cmath>
+
+#include "CLSimpleWrapper.h"
+#include "CLHostGemm.h"
+
+// General matrix multiply on top of CLSimpleWrapper: C (MxN) = A (MxK) * B (KxN), row major.
+//  One program per element type (int, float, double) is built from a single templated source,
+//  M, N and K don't need to be multiple of the tile size. Without a device (invalid session), the host backend
+//  (CLHostGemm) computes everything, the device is never touched.
+class CLGemm
+{
+public:
+    enum class Variant
+    {
+        Naive,              // one work item per element of C, straight from global memory
+        NaiveTransposed,    // B transposed on the device first, so that both operands are read along rows
+        Tiled,              // TS x TS tiles in __local memory, WPT columns of C per work item (register blocking)
+        TiledVector         // Tiled, with the tiles loaded using vload4 (int4 / float4 / double4)
+    };
+
+    enum class Backend
+    {
+        Device,     // OpenCL device only
+        Host,       // host threads only (CLHostGemm), the variant is ignored
+        Hybrid      // first rows of C on the device, the rest on the host threads at the same time,
+                    //  split by the throughput of both measured on the previous calls
+    };
+
+    explicit CLGemm(std::shared_ptr<CLSession> session);
+
+    void multiply(const int* a, const int* b, int* c, size_t M, size_t N, size_t K, Variant variant = Variant::TiledVector);
+
+    void multiply(const float* a, const float* b, float* c, size_t M, size_t N, size_t K, Variant variant = Variant::TiledVector);
+
+    void multiply(const double* a, const double* b, double* c, size_t M, size_t N, size_t K, Variant variant = Variant::TiledVector);
+
+    // out (cols x rows) = transpose of in (rows x cols), on the device (on the host with the Host backend).
+    void transpose(const int* in, int* out, size_t rows, size_t cols);
+
+    void transpose(const float* in, float* out, size_t rows, size_t cols);
+
+    void transpose(const double* in, double* out, size_t rows, size_t cols);
+
+    // record the build, transfer and kernel timings of the wrappers, see CLSimpleWrapper::getProfilingStats().
+    //  the session queue must be created with CL_QUEUE_PROFILING_ENABLE.
+    void enableProfiling(bool enable = true);
+
+    // wrapper used for the element type ("int", "float" or "double"), i.e. to read the profiling stats.
+    CLSimpleWrapper& getWrapper(const std::string& type_name);
+
+    static std::string getVariantName(Variant variant);
+
+    // Device by default, Host whatever the backend set when the session has no device.
+    void setBackend(Backend backend);
+
+    Backend getBackend() const;
+
+    // host threads of the Host and Hybrid backends, 0: one per hardware thread.
+    void setHostThreadCount(size_t thread_count);
+
+    // share of the rows of C the Hybrid backend gives to the host on the next call.
+    double getHostRatio() const;
+
+    // host reference implementation, used to check the result of multiply().
+    template<typename T>
+    static void multiplyReference(const T* a, const T* b, T* c, size_t M, size_t N, size_t K)
+    {
+        for ( size_t row = 0; row < M; row++ )
+        {
+            for ( size_t col = 0; col < N; col++ )
+            {
+                T sum = 0;
+                for ( size_t k = 0; k < K; k++ )
+                {
+                    sum += a[row * K + k] * b[k * N + col];
+                }
+                c[row * N + col] = sum;
+            }
+        }
+    }
+
+    // true when every element matches, within relative tolerance for floating point types.
+    template<typename T>
+    static bool verify(const T* expected, const T* actual, size_t count, double tolerance = 0.0)
+    {
+        for ( size_t i = 0; i < count; i++ )
+        {
+            double diff = std::fabs((double)expected[i] - (double)actual[i]);
+            if ( diff > tolerance * std::fmax(1.0, std::fabs((double)expected[i])) )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    template<typename T>
+    void run(const T* a, const T* b, T* c, size_t M, size_t N, size_t K, Variant variant, const std::string& type_name);
+
+    template<typename T>
+    void runHybrid(const T* a, const T* b, T* c, size_t M, size_t N, size_t K, Variant variant, const std::string& type_name);
+
+    template<typename T>
+    void runDevice(const T* a, const T* b, T* c, size_t M, size_t N, size_t K, Variant variant, const std::string& type_name);
+
+    template<typename T>
+    void runTranspose(const T* in, T* out, size_t rows, size_t cols, const std::string& type_name);
+
+    std::shared_ptr<CLSession> m_session;
+
+    bool m_isProfilingEnabled;
+
+    Backend m_backend;
+    CLHostGemm m_hostGemm;
+    double m_hostRatio;
+
+    std::map<std::string, std::unique_ptr<CLSimpleWrapper> > m_wrappers;    // one built program per element type
+};
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "CLHostGemm.h"
+
+// block of B kept in cache (K rows x N columns), rows of C per micro kernel, transpose tile size
+#define HOST_GEMM_KB 128
+#define HOST_GEMM_NB 512
+#define HOST_GEMM_MR 4
+#define HOST_GEMM_TT 32
+
+
+CLHostGemm::CLHostGemm(size_t thread_count)
+{
+    setThreadCount(thread_count);
+}
+
+void CLHostGemm::multiply(const int* a, const int* b, int* c, size_t M, size_t N, size_t K)
+{
+    run(a, b, c, M, N, K);
+}
+
+void CLHostGemm::multiply(const float* a, const float* b, float* c, size_t M, size_t N, size_t K)
+{
+    run(a, b, c, M, N, K);
+}
+
+void CLHostGemm::multiply(const double* a, const double* b, double* c, size_t M, size_t N, size_t K)
+{
+    run(a, b, c, M, N, K);
+}
+
+void CLHostGemm::transpose(const int* in, int* out, size_t rows, size_t cols)
+{
+    runTranspose(in, out, rows, cols);
+}
+
+void CLHostGemm::transpose(const float* in, float* out, size_t rows, size_t cols)
+{
+    runTranspose(in, out, rows, cols);
+}
+
+void CLHostGemm::transpose(const double* in, double* out, size_t rows, size_t cols)
+{
+    runTranspose(in, out, rows, cols);
+}
+
+void CLHostGemm::setThreadCount(size_t thread_count)
+{
+    m_threadCount = thread_count > 0 ? thread_count : std::max(1u, std::thread::hardware_concurrency());
+}
+
+size_t CLHostGemm::getThreadCount() const
+{
+    return m_threadCount;
+}
+
+template<typename T>
+void CLHostGemm::run(const T* a, const T* b, T* c, size_t M, size_t N, size_t K)
+{
+    // whole micro kernel row groups per thread, the calling thread takes the first range
+    size_t groups = (M + HOST_GEMM_MR - 1) / HOST_GEMM_MR;
+    size_t thread_count = std::min(m_threadCount, std::max<size_t>(1, groups));
+    size_t groups_per_thread = (groups + thread_count - 1) / thread_count;
+
+    std::vector<std::thread> threads;
+    for ( size_t t = 1; t < thread_count; t++ )
+    {
+        size_t row_begin = std::min(M, t * groups_per_thread * HOST_GEMM_MR);
+        size_t row_end = std::min(M, (t + 1) * groups_per_thread * HOST_GEMM_MR);
+        if ( row_begin < row_end )
+        {
+            threads.emplace_back(multiplyRows<T>, a, b, c, N, K, row_begin, row_end);
+        }
+    }
+    multiplyRows(a, b, c, N, K, 0, std::min(M, groups_per_thread * HOST_GEMM_MR));
+
+    for ( std::thread& thread : threads )
+    {
+        thread.join();
+    }
+}
+
+template<typename T>
+void CLHostGemm::multiplyRows(const T* a, const T* b, T* c, size_t N, size_t K, size_t row_begin, size_t row_end)
+{
+    std::fill(c + row_begin * N, c + row_end * N, (T)0);
+
+    for ( size_t kb = 0; kb < K; kb += HOST_GEMM_KB )
+    {
+        size_t k_end = std::min(K, kb + HOST_GEMM_KB);
+        for ( size_t nb = 0; nb < N; nb += HOST_GEMM_NB )
+        {
+            size_t n_len = std::min(N, nb + HOST_GEMM_NB) - nb;
+
+            size_t row = row_begin;
+            for ( ; row + HOST_GEMM_MR <= row_end; row += HOST_GEMM_MR )
+            {
+                // each element of the B block row is loaded once for four rows of C
+                T* c0 = c + row * N + nb;
+                T* c1 = c0 + N;
+                T* c2 = c1 + N;
+                T* c3 = c2 + N;
+                for ( size_t k = kb; k < k_end; k++ )
+                {
+                    const T a0 = a[row * K + k];
+                    const T a1 = a[(row + 1) * K + k];
+                    const T a2 = a[(row + 2) * K + k];
+                    const T a3 = a[(row + 3) * K + k];
+                    const T* b_row = b + k * N + nb;
+                    for ( size_t j = 0; j < n_len; j++ )
+                    {
+                        const T value = b_row[j];
+                        c0[j] += a0 * value;
+                        c1[j] += a1 * value;
+                        c2[j] += a2 * value;
+                        c3[j] += a3 * value;
+                    }
+                }
+            }
+
+            for ( ; row < row_end; row++ )
+            {
+                T* c_row = c + row * N + nb;
+                for ( size_t k = kb; k < k_end; k++ )
+                {
+                    const T a_value = a[row * K + k];
+                    const T* b_row = b + k * N + nb;
+                    for ( size_t j = 0; j < n_len; j++ )
+                    {
+                        c_row[j] += a_value * b_row[j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+template<typename T>
+void CLHostGemm::runTranspose(const T* in, T* out, size_t rows, size_t cols)
+{
+    // tiles, so that both the reads and the writes stay within a few cache lines
+    for ( size_t rb = 0; rb < rows; rb += HOST_GEMM_TT )
+    {
+        for ( size_t cb = 0; cb < cols; cb += HOST_GEMM_TT )
+        {
+            for ( size_t r = rb; r < std::min(rows, rb + HOST_GEMM_TT); r++ )
+            {
+                for ( size_t col = cb; col < std::min(cols, cb + HOST_GEMM_TT); col++ )
+                {
+                    out[col * rows + r] = in[r * cols + col];
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+
+// Matrix multiply on the host cores, the host backend of CLGemm (see CLGemm::Backend).
+//  C (MxN) = A (MxK) * B (KxN), row major, same layout as CLGemm. The rows of C are split across std::thread workers,
+//  each computes blocks of HOST_GEMM_KB x HOST_GEMM_NB of B kept in cache, four rows of C at a time,
+//  with the innermost loop running along a row of B and C so that the compiler vectorizes it.
+class CLHostGemm
+{
+public:
+    // 0: one thread per hardware thread.
+    explicit CLHostGemm(size_t thread_count = 0);
+
+    void multiply(const int* a, const int* b, int* c, size_t M, size_t N, size_t K);
+
+    void multiply(const float* a, const float* b, float* c, size_t M, size_t N, size_t K);
+
+    void multiply(const double* a, const double* b, double* c, size_t M, size_t N, size_t K);
+
+    // out (cols x rows) = transpose of in (rows x cols).
+    void transpose(const int* in, int* out, size_t rows, size_t cols);
+
+    void transpose(const float* in, float* out, size_t rows, size_t cols);
+
+    void transpose(const double* in, double* out, size_t rows, size_t cols);
+
+    void setThreadCount(size_t thread_count);
+
+    size_t getThreadCount() const;
+
+private:
+    template<typename T>
+    void run(const T* a, const T* b, T* c, size_t M, size_t N, size_t K);
+
+    template<typename T>
+    static void multiplyRows(const T* a, const T* b, T* c, size_t N, size_t K, size_t row_begin, size_t row_end);
+
+    template<typename T>
+    static void runTranspose(const T* in, T* out, size_t rows, size_t cols);
+
+    size_t m_threadCount;
+};
@@ -0,0 +1,178 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "CLMappedFile.h"
+
+
+CLMappedFile::CLMappedFile()
+    :
+#ifdef _WIN32
+    m_file(INVALID_HANDLE_VALUE),
+    m_mapping(nullptr),
+#else
+    m_fd(-1),
+#endif
+    m_size(0),
+    m_view(nullptr),
+    m_viewLen(0)
+{
+
+}
+
+CLMappedFile::~CLMappedFile()
+{
+    close();
+}
+
+bool CLMappedFile::open(const std::string& path)
+{
+    close();
+
+#ifdef _WIN32
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER size;
+    if ( INVALID_HANDLE_VALUE == m_file || !GetFileSizeEx(m_file, &size) )
+    {
+        close();
+        return false;
+    }
+    m_size = (size_t)size.QuadPart;
+
+    // an empty file can't be mapped, m_mapping stays null
+    if ( m_size > 0 )
+    {
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        if ( nullptr == m_mapping )
+        {
+            close();
+            return false;
+        }
+    }
+#else
+    m_fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if ( m_fd < 0 || 0 != fstat(m_fd, &st) )
+    {
+        close();
+        return false;
+    }
+    m_size = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+void CLMappedFile::close()
+{
+    unmap();
+
+#ifdef _WIN32
+    if ( nullptr != m_mapping )
+    {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if ( INVALID_HANDLE_VALUE != m_file )
+    {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if ( m_fd >= 0 )
+    {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+#endif
+    m_size = 0;
+}
+
+size_t CLMappedFile::getSize() const
+{
+    return m_size;
+}
+
+const void* CLMappedFile::map(size_t offset, size_t len)
+{
+    unmap();
+
+    if ( 0 == len && offset < m_size )
+    {
+        len = m_size - offset;
+    }
+    if ( 0 == len || offset + len > m_size )
+    {
+        return nullptr;
+    }
+
+    // the view must start on a page boundary, the part before offset is mapped too
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    size_t granularity = info.dwAllocationGranularity;
+#else
+    size_t granularity = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+    size_t view_offset = offset / granularity * granularity;
+    size_t view_len = len + (offset - view_offset);
+
+#ifdef _WIN32
+    m_view = MapViewOfFile(m_mapping, FILE_MAP_COPY, (DWORD)((unsigned long long)view_offset >> 32),
+        (DWORD)(view_offset & 0xFFFFFFFF), view_len);
+#else
+    m_view = mmap(nullptr, view_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, m_fd, (off_t)view_offset);
+    if ( MAP_FAILED == m_view )
+    {
+        m_view = nullptr;
+    }
+#endif
+    if ( nullptr == m_view )
+    {
+        return nullptr;
+    }
+    m_viewLen = view_len;
+
+#ifndef _WIN32
+    madvise(m_view, m_viewLen, MADV_SEQUENTIAL);
+#endif
+    return static_cast<const char*>(m_view) + (offset - view_offset);
+}
+
+void CLMappedFile::unmap()
+{
+    if ( nullptr == m_view )
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_view);
+#else
+    munmap(m_view, m_viewLen);
+#endif
+    m_view = nullptr;
+    m_viewLen = 0;
+}
+
+void CLMappedFile::prefetch()
+{
+#ifndef _WIN32
+    if ( nullptr != m_view )
+    {
+        madvise(m_view, m_viewLen, MADV_WILLNEED);
+    }
+#endif
+}
+
+size_t CLMappedFile::getFileSize(const std::string& path)
+{
+    CLMappedFile file;
+    return file.open(path) ? file.getSize() : 0;
+}
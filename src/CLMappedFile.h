@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+
+// Read-only view of a range of a file in the address space (mmap / MapViewOfFile): nothing is read up front,
+//  the pages are loaded from disk on first access and can be dropped by the OS under memory pressure.
+//  The view is copy-on-write, so writes (i.e. by a driver using the pages in place) never reach the file.
+class CLMappedFile
+{
+public:
+    CLMappedFile();
+    ~CLMappedFile();
+
+    CLMappedFile(const CLMappedFile&) = delete;
+    CLMappedFile& operator=(const CLMappedFile&) = delete;
+
+    // false when the file doesn't exist or can't be read.
+    bool open(const std::string& path);
+
+    void close();
+
+    size_t getSize() const;
+
+    // map len bytes at offset (0: up to the end of the file), replacing the previous view.
+    //  the returned pointer is at offset, page aligned when offset is. nullptr when the range is outside of the file.
+    const void* map(size_t offset, size_t len = 0);
+
+    void unmap();
+
+    // hint the OS to read the pages of the view ahead, asynchronously (no-op on Windows).
+    void prefetch();
+
+    // 0 when the file doesn't exist.
+    static size_t getFileSize(const std::string& path);
+
+private:
+#ifdef _WIN32
+    void* m_file;       // HANDLE
+    void* m_mapping;    // HANDLE
+#else
+    int m_fd;
+#endif
+    size_t m_size;
+
+    void* m_view;       // start of the view, aligned down to the page (allocation granularity on Windows)
+    size_t m_viewLen;
+};
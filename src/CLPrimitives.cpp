@@ -0,0 +1,586 @@
+#include <limits>
+#include <string>
+
+#include "CLPrimitives.h"
+
+// work group size, elements per work item of the reduce and scan blocks, radix sort digit width
+#define PRIM_WG 256
+#define PRIM_ITEMS 8
+#define PRIM_RADIX_BITS 4
+#define PRIM_RADIX (1 << PRIM_RADIX_BITS)
+
+// wrapper buffer indices, the block results of the level N pass are in PRIM_LEVEL_BUFFER + N
+#define PRIM_DATA 0
+#define PRIM_OUTPUT 1
+#define PRIM_FLAGS 2
+#define PRIM_POSITIONS 3
+#define PRIM_HISTOGRAM 4
+#define PRIM_LEVEL_BUFFER 8
+
+// key_mode of runSort(), same values as the sortKeyTransform kernel
+#define PRIM_KEYS_UINT 0
+#define PRIM_KEYS_INT 1
+#define PRIM_KEYS_FLOAT 2
+
+// built once per element type with -D T=<type>, USE_FP64 enables double precision.
+//  the sort kernels always work on uint keys, they are only used from the uint build.
+static const std::string ClSrcPrimitives = R"CLC(
+#ifdef USE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+#define BLOCK (WG * ITEMS)  // elements per work group of reduce, scanBlocks and addOffsets
+#define RADIX (1 << RADIX_BITS)
+
+// same order as CLPrimitives::ReduceOp
+#define OP_SUM 0
+#define OP_MIN 1
+
+T combine(const T a, const T b, const int op)
+{
+    return (OP_SUM == op) ? a + b : (OP_MIN == op) ? ((b < a) ? b : a) : ((a < b) ? b : a);
+}
+
+// inclusive scan of the WG values in local memory (Hillis-Steele), every work item of the group must call it.
+void localScan(__local T* data, const uint lid)
+{
+    for ( uint offset = 1; offset < WG; offset <<= 1 )
+    {
+        barrier(CLK_LOCAL_MEM_FENCE);
+        const T value = (lid >= offset) ? data[lid - offset] : (T)0;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        data[lid] += value;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+void localScanUint(__local uint* data, const uint lid)
+{
+    for ( uint offset = 1; offset < WG; offset <<= 1 )
+    {
+        barrier(CLK_LOCAL_MEM_FENCE);
+        const uint value = (lid >= offset) ? data[lid - offset] : 0;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        data[lid] += value;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+// out[group] = in[group * BLOCK] op ... op in[group * BLOCK + BLOCK - 1], local size WG
+__kernel void reduce(const uint n, const int op, const T identity,
+    __global const T* in, __global T* out)
+{
+    __local T partial[WG];
+    const uint lid = get_local_id(0);
+    const uint base = get_group_id(0) * BLOCK;
+
+    // consecutive work items read consecutive elements
+    T acc = identity;
+    for ( uint i = 0; i < ITEMS; i++ )
+    {
+        const uint idx = base + i * WG + lid;
+        if ( idx < n )
+        {
+            acc = combine(acc, in[idx], op);
+        }
+    }
+    partial[lid] = acc;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for ( uint stride = WG / 2; stride > 0; stride >>= 1 )
+    {
+        if ( lid < stride )
+        {
+            partial[lid] = combine(partial[lid], partial[lid + stride], op);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if ( 0 == lid )
+    {
+        out[get_group_id(0)] = partial[0];
+    }
+}
+
+// prefix sum of each block of BLOCK elements, block_sums[group] is the total of the block.
+//  the block is loaded into local memory, so in and out may be the same buffer.
+__kernel void scanBlocks(const uint n, const int exclusive,
+    __global const T* in, __global T* out, __global T* block_sums)
+{
+    __local T block[BLOCK];
+    __local T sums[WG];
+    const uint lid = get_local_id(0);
+    const uint base = get_group_id(0) * BLOCK;
+
+    for ( uint i = 0; i < ITEMS; i++ )
+    {
+        const uint idx = base + i * WG + lid;
+        block[i * WG + lid] = (idx < n) ? in[idx] : (T)0;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // each work item scans ITEMS consecutive elements, the work item totals are scanned across the group
+    T total = 0;
+    for ( uint i = 0; i < ITEMS; i++ )
+    {
+        total += block[lid * ITEMS + i];
+    }
+    sums[lid] = total;
+    localScan(sums, lid);
+
+    T prefix = (lid > 0) ? sums[lid - 1] : (T)0;
+    for ( uint i = 0; i < ITEMS; i++ )
+    {
+        const T value = block[lid * ITEMS + i];
+        block[lid * ITEMS + i] = exclusive ? prefix : prefix + value;
+        prefix += value;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for ( uint i = 0; i < ITEMS; i++ )
+    {
+        const uint idx = base + i * WG + lid;
+        if ( idx < n )
+        {
+            out[idx] = block[i * WG + lid];
+        }
+    }
+    if ( WG - 1 == lid )
+    {
+        block_sums[get_group_id(0)] = sums[WG - 1];
+    }
+}
+
+// add the exclusive scan of the block sums to every element of the block
+__kernel void addOffsets(const uint n, __global T* data, __global const T* block_offsets)
+{
+    const uint lid = get_local_id(0);
+    const uint base = get_group_id(0) * BLOCK;
+    const T offset = block_offsets[get_group_id(0)];
+
+    for ( uint i = 0; i < ITEMS; i++ )
+    {
+        const uint idx = base + i * WG + lid;
+        if ( idx < n )
+        {
+            data[idx] += offset;
+        }
+    }
+}
+
+// positions is the exclusive scan of flags
+__kernel void compactScatter(const uint n, __global const T* in, __global const uint* flags,
+    __global const uint* positions, __global T* out)
+{
+    const uint i = get_global_id(0);
+    if ( i < n && flags[i] )
+    {
+        out[positions[i]] = in[i];
+    }
+}
+
+// map int (mode 1) and float (mode 2) keys to uint keys of the same order, and back when decode is set.
+__kernel void sortKeyTransform(const uint n, const int mode, const int decode, __global uint* keys)
+{
+    const uint i = get_global_id(0);
+    if ( i >= n )
+    {
+        return;
+    }
+
+    const uint key = keys[i];
+    if ( 1 == mode )
+    {
+        keys[i] = key ^ 0x80000000u;
+    }
+    else if ( !decode )
+    {
+        // negative floats: reverse the order of all the bits, positive floats: above every negative one
+        keys[i] = key ^ ((key >> 31) ? 0xFFFFFFFFu : 0x80000000u);
+    }
+    else
+    {
+        keys[i] = key ^ ((key >> 31) ? 0x80000000u : 0xFFFFFFFFu);
+    }
+}
+
+// digit histogram of each block of WG keys, stored digit major: histogram[digit * groups + group],
+//  so that its exclusive scan is the output position of the first key of each digit and block.
+__kernel void sortHistogram(const uint n, const uint shift,
+    __global const uint* keys, __global uint* histogram)
+{
+    __local uint counts[RADIX];
+    const uint lid = get_local_id(0);
+    const uint i = get_global_id(0);
+
+    if ( lid < RADIX )
+    {
+        counts[lid] = 0;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if ( i < n )
+    {
+        atomic_inc(&counts[(keys[i] >> shift) & (RADIX - 1)]);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if ( lid < RADIX )
+    {
+        histogram[lid * get_num_groups(0) + get_group_id(0)] = counts[lid];
+    }
+}
+
+// stable scatter of each block of WG keys: the block is sorted by digit in local memory (one 1-bit split per bit
+//  of the digit), so the rank of a key within its digit is its distance to the first key of the digit.
+__kernel void sortScatter(const uint n, const uint shift,
+    __global const uint* keys_in, __global uint* keys_out, __global const uint* offsets)
+{
+    __local uint block[WG];
+    __local uint zeros[WG];
+    __local uint digit_start[RADIX];
+    const uint lid = get_local_id(0);
+    const uint i = get_global_id(0);
+    const uint valid = min((uint)WG, n - (uint)get_group_id(0) * WG);
+
+    // padding keys have the highest digit, they stay behind the valid keys of the block
+    block[lid] = (i < n) ? keys_in[i] : 0xFFFFFFFFu;
+
+    for ( uint bit = 0; bit < RADIX_BITS; bit++ )
+    {
+        barrier(CLK_LOCAL_MEM_FENCE);
+        const uint key = block[lid];
+        const uint is_one = (key >> (shift + bit)) & 1;
+        zeros[lid] = 1 - is_one;
+        localScanUint(zeros, lid);
+
+        const uint zeros_before = zeros[lid] - (1 - is_one);
+        const uint total_zeros = zeros[WG - 1];
+        barrier(CLK_LOCAL_MEM_FENCE);
+        block[is_one ? total_zeros + lid - zeros_before : zeros_before] = key;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    const uint key = block[lid];
+    const uint digit = (key >> shift) & (RADIX - 1);
+    if ( 0 == lid || digit != ((block[lid - 1] >> shift) & (RADIX - 1)) )
+    {
+        digit_start[digit] = lid;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if ( lid < valid )
+    {
+        keys_out[offsets[digit * get_num_groups(0) + get_group_id(0)] + lid - digit_start[digit]] = key;
+    }
+}
+)CLC";
+
+static size_t divUp(size_t value, size_t divisor)
+{
+    return (value + divisor - 1) / divisor;
+}
+
+CLPrimitives::CLPrimitives(std::shared_ptr<CLSession> session)
+    : m_source(ClSrcPrimitives),
+    m_wrapper(session)
+{
+
+}
+
+int CLPrimitives::reduce(const int* in, size_t count, ReduceOp op)
+{
+    return runReduce(in, count, op, "int");
+}
+
+unsigned int CLPrimitives::reduce(const unsigned int* in, size_t count, ReduceOp op)
+{
+    return runReduce(in, count, op, "uint");
+}
+
+float CLPrimitives::reduce(const float* in, size_t count, ReduceOp op)
+{
+    return runReduce(in, count, op, "float");
+}
+
+double CLPrimitives::reduce(const double* in, size_t count, ReduceOp op)
+{
+    return runReduce(in, count, op, "double");
+}
+
+void CLPrimitives::scan(const int* in, int* out, size_t count, bool is_exclusive)
+{
+    runScan(in, out, count, is_exclusive, "int");
+}
+
+void CLPrimitives::scan(const unsigned int* in, unsigned int* out, size_t count, bool is_exclusive)
+{
+    runScan(in, out, count, is_exclusive, "uint");
+}
+
+void CLPrimitives::scan(const float* in, float* out, size_t count, bool is_exclusive)
+{
+    runScan(in, out, count, is_exclusive, "float");
+}
+
+void CLPrimitives::scan(const double* in, double* out, size_t count, bool is_exclusive)
+{
+    runScan(in, out, count, is_exclusive, "double");
+}
+
+size_t CLPrimitives::compact(const int* in, const unsigned int* flags, int* out, size_t count)
+{
+    return runCompact(in, flags, out, count, "int");
+}
+
+size_t CLPrimitives::compact(const unsigned int* in, const unsigned int* flags, unsigned int* out, size_t count)
+{
+    return runCompact(in, flags, out, count, "uint");
+}
+
+size_t CLPrimitives::compact(const float* in, const unsigned int* flags, float* out, size_t count)
+{
+    return runCompact(in, flags, out, count, "float");
+}
+
+size_t CLPrimitives::compact(const double* in, const unsigned int* flags, double* out, size_t count)
+{
+    return runCompact(in, flags, out, count, "double");
+}
+
+void CLPrimitives::sort(unsigned int* keys, size_t count)
+{
+    runSort(keys, count, PRIM_KEYS_UINT);
+}
+
+void CLPrimitives::sort(int* keys, size_t count)
+{
+    runSort(keys, count, PRIM_KEYS_INT);
+}
+
+void CLPrimitives::sort(float* keys, size_t count)
+{
+    runSort(keys, count, PRIM_KEYS_FLOAT);
+}
+
+void CLPrimitives::enableProfiling(bool enable)
+{
+    m_wrapper.enableProfiling(enable);
+}
+
+CLSimpleWrapper& CLPrimitives::getWrapper()
+{
+    return m_wrapper;
+}
+
+void CLPrimitives::selectKernel(const std::string& type_name, const std::string& kernel_name)
+{
+    std::map<std::string, std::string> defines;
+    defines["T"] = type_name;
+    defines["WG"] = std::to_string(PRIM_WG);
+    defines["ITEMS"] = std::to_string(PRIM_ITEMS);
+    defines["RADIX_BITS"] = std::to_string(PRIM_RADIX_BITS);
+    if ( type_name == "double" )
+    {
+        defines["USE_FP64"] = "";
+    }
+
+    cl_int error = m_wrapper.selectKernelVariant(m_source, kernel_name, CLSimpleWrapper::makeBuildOptions(defines));
+    CLSimpleWrapper::checkCLError(error, "Build Primitives Program Failed");
+}
+
+void CLPrimitives::scanBuffer(const std::string& type_name, size_t elem_size, size_t in_index, size_t out_index,
+    size_t count, bool is_exclusive, size_t level)
+{
+    size_t groups = divUp(count, PRIM_WG * PRIM_ITEMS);
+    size_t sums_index = PRIM_LEVEL_BUFFER + level;
+    m_wrapper.createScratchBuffer(sums_index, groups * elem_size);
+
+    cl_uint n = (cl_uint)count;
+    cl_int exclusive = is_exclusive ? 1 : 0;
+    selectKernel(type_name, "scanBlocks");
+    m_wrapper.setKernelArg(0, &n, sizeof(cl_uint));
+    m_wrapper.setKernelArg(1, &exclusive, sizeof(cl_int));
+    m_wrapper.bindKernelBufferArg(2, in_index);
+    m_wrapper.bindKernelBufferArg(3, out_index);
+    m_wrapper.bindKernelBufferArg(4, sums_index);
+
+    size_t global_item_size = groups * PRIM_WG;
+    size_t local_item_size = PRIM_WG;
+    m_wrapper.executeKernel(1, &global_item_size, &local_item_size);
+
+    if ( groups > 1 )
+    {
+        // block sums -> block offsets, in place, then added to every block
+        scanBuffer(type_name, elem_size, sums_index, sums_index, groups, true, level + 1);
+
+        selectKernel(type_name, "addOffsets");
+        m_wrapper.setKernelArg(0, &n, sizeof(cl_uint));
+        m_wrapper.bindKernelBufferArg(1, out_index);
+        m_wrapper.bindKernelBufferArg(2, sums_index);
+        m_wrapper.executeKernel(1, &global_item_size, &local_item_size);
+    }
+}
+
+template<typename T>
+T CLPrimitives::runReduce(const T* in, size_t count, ReduceOp op, const std::string& type_name)
+{
+    T identity = (ReduceOp::Sum == op) ? (T)0 :
+        (ReduceOp::Min == op) ? std::numeric_limits<T>::max() : std::numeric_limits<T>::lowest();
+    if ( 0 == count )
+    {
+        return identity;
+    }
+
+    m_wrapper.createScratchBuffer(PRIM_DATA, count * sizeof(T));
+    m_wrapper.writeBuffer(PRIM_DATA, in, count * sizeof(T));
+
+    // one partial result per block, reduced again until a single block is left
+    cl_int op_code = (cl_int)op;
+    size_t in_index = PRIM_DATA;
+    size_t level = 0;
+    do
+    {
+        size_t groups = divUp(count, PRIM_WG * PRIM_ITEMS);
+        size_t out_index = PRIM_LEVEL_BUFFER + level;
+        m_wrapper.createScratchBuffer(out_index, groups * sizeof(T));
+
+        cl_uint n = (cl_uint)count;
+        selectKernel(type_name, "reduce");
+        m_wrapper.setKernelArg(0, &n, sizeof(cl_uint));
+        m_wrapper.setKernelArg(1, &op_code, sizeof(cl_int));
+        m_wrapper.setKernelArg(2, &identity, sizeof(T));
+        m_wrapper.bindKernelBufferArg(3, in_index);
+        m_wrapper.bindKernelBufferArg(4, out_index);
+
+        size_t global_item_size = groups * PRIM_WG;
+        size_t local_item_size = PRIM_WG;
+        m_wrapper.executeKernel(1, &global_item_size, &local_item_size);
+
+        count = groups;
+        in_index = out_index;
+        level++;
+    } while ( count > 1 );
+
+    T result;
+    m_wrapper.readBuffer(&result, in_index, sizeof(T));
+    return result;
+}
+
+template<typename T>
+void CLPrimitives::runScan(const T* in, T* out, size_t count, bool is_exclusive, const std::string& type_name)
+{
+    if ( 0 == count )
+    {
+        return;
+    }
+
+    m_wrapper.createScratchBuffer(PRIM_DATA, count * sizeof(T));
+    m_wrapper.writeBuffer(PRIM_DATA, in, count * sizeof(T));
+    scanBuffer(type_name, sizeof(T), PRIM_DATA, PRIM_DATA, count, is_exclusive, 0);
+    m_wrapper.readBuffer(out, PRIM_DATA, count * sizeof(T));
+}
+
+template<typename T>
+size_t CLPrimitives::runCompact(const T* in, const unsigned int* flags, T* out, size_t count, const std::string& type_name)
+{
+    if ( 0 == count )
+    {
+        return 0;
+    }
+
+    m_wrapper.createScratchBuffer(PRIM_DATA, count * sizeof(T));
+    m_wrapper.writeBuffer(PRIM_DATA, in, count * sizeof(T));
+    m_wrapper.createScratchBuffer(PRIM_FLAGS, count * sizeof(cl_uint));
+    m_wrapper.writeBuffer(PRIM_FLAGS, flags, count * sizeof(cl_uint));
+    m_wrapper.createScratchBuffer(PRIM_POSITIONS, count * sizeof(cl_uint));
+
+    // output position of every selected element, the last position gives the selected count
+    scanBuffer("uint", sizeof(cl_uint), PRIM_FLAGS, PRIM_POSITIONS, count, true, 0);
+    cl_uint last_position = 0;
+    m_wrapper.readBuffer(&last_position, PRIM_POSITIONS, sizeof(cl_uint), (count - 1) * sizeof(cl_uint));
+    size_t selected = last_position + flags[count - 1];
+    if ( 0 == selected )
+    {
+        return 0;
+    }
+
+    cl_uint n = (cl_uint)count;
+    m_wrapper.createScratchBuffer(PRIM_OUTPUT, selected * sizeof(T));
+    selectKernel(type_name, "compactScatter");
+    m_wrapper.setKernelArg(0, &n, sizeof(cl_uint));
+    m_wrapper.bindKernelBufferArg(1, PRIM_DATA);
+    m_wrapper.bindKernelBufferArg(2, PRIM_FLAGS);
+    m_wrapper.bindKernelBufferArg(3, PRIM_POSITIONS);
+    m_wrapper.bindKernelBufferArg(4, PRIM_OUTPUT);
+
+    size_t global_item_size = divUp(count, PRIM_WG) * PRIM_WG;
+    size_t local_item_size = PRIM_WG;
+    m_wrapper.executeKernel(1, &global_item_size, &local_item_size);
+
+    m_wrapper.readBuffer(out, PRIM_OUTPUT, selected * sizeof(T));
+    return selected;
+}
+
+void CLPrimitives::runSort(void* keys, size_t count, int key_mode)
+{
+    if ( count < 2 )
+    {
+        return;
+    }
+
+    size_t groups = divUp(count, PRIM_WG);
+    m_wrapper.createScratchBuffer(PRIM_DATA, count * sizeof(cl_uint));
+    m_wrapper.writeBuffer(PRIM_DATA, keys, count * sizeof(cl_uint));
+    m_wrapper.createScratchBuffer(PRIM_OUTPUT, count * sizeof(cl_uint));
+    m_wrapper.createScratchBuffer(PRIM_HISTOGRAM, groups * PRIM_RADIX * sizeof(cl_uint));
+
+    cl_uint n = (cl_uint)count;
+    cl_int mode = key_mode;
+    size_t global_item_size = groups * PRIM_WG;
+    size_t local_item_size = PRIM_WG;
+    auto transformKeys = [&](cl_int decode)
+    {
+        selectKernel("uint", "sortKeyTransform");
+        m_wrapper.setKernelArg(0, &n, sizeof(cl_uint));
+        m_wrapper.setKernelArg(1, &mode, sizeof(cl_int));
+        m_wrapper.setKernelArg(2, &decode, sizeof(cl_int));
+        m_wrapper.bindKernelBufferArg(3, PRIM_DATA);
+        m_wrapper.executeKernel(1, &global_item_size, &local_item_size);
+    };
+
+    if ( PRIM_KEYS_UINT != key_mode )
+    {
+        transformKeys(0);
+    }
+
+    // even number of passes: the keys go back and forth between the two buffers, and end up in PRIM_DATA
+    for ( cl_uint shift = 0; shift < 32; shift += PRIM_RADIX_BITS )
+    {
+        size_t src_index = (0 == (shift / PRIM_RADIX_BITS) % 2) ? PRIM_DATA : PRIM_OUTPUT;
+        size_t dst_index = (PRIM_DATA == src_index) ? PRIM_OUTPUT : PRIM_DATA;
+
+        selectKernel("uint", "sortHistogram");
+        m_wrapper.setKernelArg(0, &n, sizeof(cl_uint));
+        m_wrapper.setKernelArg(1, &shift, sizeof(cl_uint));
+        m_wrapper.bindKernelBufferArg(2, src_index);
+        m_wrapper.bindKernelBufferArg(3, PRIM_HISTOGRAM);
+        m_wrapper.executeKernel(1, &global_item_size, &local_item_size);
+
+        scanBuffer("uint", sizeof(cl_uint), PRIM_HISTOGRAM, PRIM_HISTOGRAM, groups * PRIM_RADIX, true, 0);
+
+        selectKernel("uint", "sortScatter");
+        m_wrapper.setKernelArg(0, &n, sizeof(cl_uint));
+        m_wrapper.setKernelArg(1, &shift, sizeof(cl_uint));
+        m_wrapper.bindKernelBufferArg(2, src_index);
+        m_wrapper.bindKernelBufferArg(3, dst_index);
+        m_wrapper.bindKernelBufferArg(4, PRIM_HISTOGRAM);
+        m_wrapper.executeKernel(1, &global_item_size, &local_item_size);
+    }
+
+    if ( PRIM_KEYS_UINT != key_mode )
+    {
+        transformKeys(1);
+    }
+    m_wrapper.readBuffer(keys, PRIM_DATA, count * sizeof(cl_uint));
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+
+#include "CLSimpleWrapper.h"
+
+// Data parallel building blocks on top of CLSimpleWrapper: reduction, prefix scan, stream compaction and radix sort.
+//  Every primitive is multi-pass: each work group processes a block of elements in __local memory, and the per block
+//  results (partial reductions, block sums, digit histograms) are processed again until one block is left, so the
+//  element count is only limited by the device memory (and by 32 bit indices: less than 4G elements).
+//  The kernels are variants of one templated source per element type (int, unsigned int, float, double),
+//  selected with CLSimpleWrapper::selectKernelVariant(), so that all the passes share the buffers of one wrapper.
+class CLPrimitives
+{
+public:
+    enum class ReduceOp
+    {
+        Sum,
+        Min,
+        Max
+    };
+
+    explicit CLPrimitives(std::shared_ptr<CLSession> session);
+
+    // sum, minimum or maximum of the count elements, the identity of the operation when count is 0.
+    int reduce(const int* in, size_t count, ReduceOp op = ReduceOp::Sum);
+
+    unsigned int reduce(const unsigned int* in, size_t count, ReduceOp op = ReduceOp::Sum);
+
+    float reduce(const float* in, size_t count, ReduceOp op = ReduceOp::Sum);
+
+    double reduce(const double* in, size_t count, ReduceOp op = ReduceOp::Sum);
+
+    // prefix sum: out[i] = in[0] + ... + in[i], or in[0] + ... + in[i - 1] (out[0] = 0) when exclusive.
+    //  in and out may be the same array.
+    void scan(const int* in, int* out, size_t count, bool is_exclusive = false);
+
+    void scan(const unsigned int* in, unsigned int* out, size_t count, bool is_exclusive = false);
+
+    void scan(const float* in, float* out, size_t count, bool is_exclusive = false);
+
+    void scan(const double* in, double* out, size_t count, bool is_exclusive = false);
+
+    // copy the elements with a flag of 1 (flags are 0 or 1) to out, in order. Returns the number of elements copied,
+    //  out must have room for all of them.
+    size_t compact(const int* in, const unsigned int* flags, int* out, size_t count);
+
+    size_t compact(const unsigned int* in, const unsigned int* flags, unsigned int* out, size_t count);
+
+    size_t compact(const float* in, const unsigned int* flags, float* out, size_t count);
+
+    size_t compact(const double* in, const unsigned int* flags, double* out, size_t count);
+
+    // ascending in place LSD radix sort, 4 bits per pass. Signed and floating point keys are mapped to unsigned keys
+    //  of the same order on the device (negative zero sorts before zero).
+    void sort(unsigned int* keys, size_t count);
+
+    void sort(int* keys, size_t count);
+
+    void sort(float* keys, size_t count);
+
+    // record the transfer and kernel timings of every pass, see CLSimpleWrapper::getProfilingStats().
+    //  the session queue must be created with CL_QUEUE_PROFILING_ENABLE.
+    void enableProfiling(bool enable = true);
+
+    CLSimpleWrapper& getWrapper();
+
+private:
+    // select the kernel of the element type ("int", "uint", "float" or "double"), built on first use.
+    void selectKernel(const std::string& type_name, const std::string& kernel_name);
+
+    // multi-pass prefix sum of the buffer in_index into out_index (may be the same buffer),
+    //  level is the depth of the recursion on the block sums, each level has its own block sums buffer.
+    void scanBuffer(const std::string& type_name, size_t elem_size, size_t in_index, size_t out_index,
+        size_t count, bool is_exclusive, size_t level);
+
+    template<typename T>
+    T runReduce(const T* in, size_t count, ReduceOp op, const std::string& type_name);
+
+    template<typename T>
+    void runScan(const T* in, T* out, size_t count, bool is_exclusive, const std::string& type_name);
+
+    template<typename T>
+    size_t runCompact(const T* in, const unsigned int* flags, T* out, size_t count, const std::string& type_name);
+
+    // key_mode: how the keys are mapped to unsigned keys, see the sortKeyTransform kernel.
+    void runSort(void* keys, size_t count, int key_mode);
+
+    std::string m_source;   // selectKernelVariant() takes the source by reference
+
+    CLSimpleWrapper m_wrapper;
+};
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <utility>
+
+#include "CLProfiler.h"
+
+
+CLProfiler::CLProfiler()
+    : m_enabled(false)
+{
+
+}
+
+CLProfiler::~CLProfiler()
+{
+    reset();
+}
+
+void CLProfiler::setEnabled(bool enable)
+{
+    m_enabled = enable;
+}
+
+bool CLProfiler::isEnabled() const
+{
+    return m_enabled;
+}
+
+void CLProfiler::recordEvent(cl_event event, const std::string& name, const std::string& category)
+{
+    if ( !m_enabled || nullptr == event )
+    {
+        return;
+    }
+
+    clRetainEvent(event);
+    m_pendingEvents.push_back({ event, name, category });
+}
+
+void CLProfiler::recordHost(const std::string& name, const std::string& category,
+    std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    if ( !m_enabled )
+    {
+        return;
+    }
+
+    cl_ulong start_ns = (cl_ulong)std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+    cl_ulong end_ns = (cl_ulong)std::chrono::duration_cast<std::chrono::nanoseconds>(end.time_since_epoch()).count();
+    m_records.push_back({ name, category, true, start_ns, start_ns, start_ns, end_ns });
+}
+
+std::vector<CLProfileRecord> CLProfiler::getRecords()
+{
+    resolvePendingEvents();
+    return m_records;
+}
+
+std::vector<CLProfileStats> CLProfiler::getStats()
+{
+    resolvePendingEvents();
+
+    std::map<std::pair<std::string, std::string>, std::vector<double> > durations;
+    for ( const CLProfileRecord& record : m_records )
+    {
+        durations[std::make_pair(record.category, record.name)].push_back((record.end_ns - record.start_ns) * 1e-6);
+    }
+
+    std::vector<CLProfileStats> stats;
+    for ( auto& entry : durations )
+    {
+        std::vector<double>& values = entry.second;
+        std::sort(values.begin(), values.end());
+
+        // nearest-rank percentile
+        auto percentile = [&values](double p)
+        {
+            size_t rank = (size_t)std::ceil(p * values.size());
+            return values[std::min(values.size(), std::max<size_t>(rank, 1)) - 1];
+        };
+
+        CLProfileStats stat;
+        stat.category = entry.first.first;
+        stat.name = entry.first.second;
+        stat.count = values.size();
+        stat.total_ms = 0.0;
+        for ( double value : values )
+        {
+            stat.total_ms += value;
+        }
+        stat.min_ms = values.front();
+        stat.max_ms = values.back();
+        stat.p50_ms = percentile(0.50);
+        stat.p90_ms = percentile(0.90);
+        stat.p99_ms = percentile(0.99);
+        stats.push_back(stat);
+    }
+
+    return stats;
+}
+
+bool CLProfiler::writeChromeTrace(const std::string& path)
+{
+    resolvePendingEvents();
+
+    std::ofstream ofs(path, std::ios::trunc);
+    if ( !ofs )
+    {
+        std::cerr << "Unable to write trace: " << path << '\n';
+        return false;
+    }
+
+    // device and host clocks are unrelated, each one gets its own process and starts at 0.
+    cl_ulong device_origin = ~(cl_ulong)0;
+    cl_ulong host_origin = ~(cl_ulong)0;
+    for ( const CLProfileRecord& record : m_records )
+    {
+        cl_ulong& origin = record.is_host ? host_origin : device_origin;
+        origin = std::min(origin, record.queued_ns);
+    }
+
+    ofs << "{\"traceEvents\":[\n";
+    ofs << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"device\"}},\n";
+    ofs << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"host\"}}";
+    for ( const CLProfileRecord& record : m_records )
+    {
+        cl_ulong origin = record.is_host ? host_origin : device_origin;
+        ofs << ",\n{\"name\":\"" << record.name << "\",\"cat\":\"" << record.category << "\",\"ph\":\"X\""
+            << ",\"pid\":" << (record.is_host ? 1 : 0) << ",\"tid\":\"" << record.category << "\""
+            << ",\"ts\":" << (record.start_ns - origin) * 1e-3
+            << ",\"dur\":" << (record.end_ns - record.start_ns) * 1e-3
+            << ",\"args\":{\"queued_us\":" << (record.queued_ns - origin) * 1e-3
+            << ",\"submit_us\":" << (record.submit_ns - origin) * 1e-3 << "}}";
+    }
+    ofs << "\n]}\n";
+
+    return true;
+}
+
+void CLProfiler::reset()
+{
+    for ( PendingEvent& pending : m_pendingEvents )
+    {
+        clReleaseEvent(pending.event);
+    }
+    m_pendingEvents.clear();
+    m_records.clear();
+}
+
+void CLProfiler::resolvePendingEvents()
+{
+    for ( PendingEvent& pending : m_pendingEvents )
+    {
+        CLProfileRecord record = { pending.name, pending.category, false, 0, 0, 0, 0 };
+
+        clWaitForEvents(1, &pending.event);
+        clGetEventProfilingInfo(pending.event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &record.queued_ns, nullptr);
+        clGetEventProfilingInfo(pending.event, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &record.submit_ns, nullptr);
+        clGetEventProfilingInfo(pending.event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &record.start_ns, nullptr);
+        clGetEventProfilingInfo(pending.event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &record.end_ns, nullptr);
+        clReleaseEvent(pending.event);
+
+        m_records.push_back(record);
+    }
+    m_pendingEvents.clear();
+}
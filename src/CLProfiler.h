@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include "CLConfig.h"
+
+// one profiled command, device commands use the device clock, host records (i.e. program build) the host clock.
+struct CLProfileRecord
+{
+    std::string name;       // kernel name, or buffer name for transfers
+    std::string category;   // "kernel", "write", "read", "map", "unmap", "build"
+    bool is_host;
+    cl_ulong queued_ns;
+    cl_ulong submit_ns;
+    cl_ulong start_ns;
+    cl_ulong end_ns;
+};
+
+// aggregated execution time (start to end) of the records with the same category and name.
+struct CLProfileStats
+{
+    std::string name;
+    std::string category;
+    size_t count;
+    double total_ms;
+    double min_ms;
+    double max_ms;
+    double p50_ms;
+    double p90_ms;
+    double p99_ms;
+};
+
+// Collects the timings of the commands enqueued by CLSimpleWrapper.
+//  events are only retained when recorded, the profiling info is queried lazily (getRecords(), getStats(), ...),
+//  so that recording does not add any host synchronization. Requires CL_QUEUE_PROFILING_ENABLE on the queue.
+class CLProfiler
+{
+public:
+    CLProfiler();
+    ~CLProfiler();
+
+    void setEnabled(bool enable);
+
+    bool isEnabled() const;
+
+    // retain the event until it is resolved, nullptr is ignored.
+    void recordEvent(cl_event event, const std::string& name, const std::string& category);
+
+    void recordHost(const std::string& name, const std::string& category,
+        std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+    // wait for the pending events, and return every record so far.
+    std::vector<CLProfileRecord> getRecords();
+
+    std::vector<CLProfileStats> getStats();
+
+    // Chrome trace event format, open it with chrome://tracing or https://ui.perfetto.dev
+    bool writeChromeTrace(const std::string& path);
+
+    void reset();
+
+private:
+    struct PendingEvent
+    {
+        cl_event event;
+        std::string name;
+        std::string category;
+    };
+
+    void resolvePendingEvents();
+
+    bool m_enabled;
+
+    std::vector<PendingEvent> m_pendingEvents;
+    std::vector<CLProfileRecord> m_records;
+};
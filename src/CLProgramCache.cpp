@@ -0,0 +1,183 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+
+#include "CLProgramCache.h"
+
+// replace path by the file tmp_path, atomically: readers see either the old or the new file.
+static bool replaceFile(const std::string& tmp_path, const std::string& path)
+{
+#ifdef _WIN32
+    return 0 != MoveFileExA(tmp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    return 0 == std::rename(tmp_path.c_str(), path.c_str());
+#endif
+}
+
+// temporary file name unique to the process and the call, threads and processes may store the same entry.
+static std::string getTempPath(const std::string& path)
+{
+    static std::atomic<unsigned int> s_counter(0);
+#ifdef _WIN32
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = (unsigned long)getpid();
+#endif
+    return path + "." + std::to_string(pid) + "." + std::to_string(s_counter++) + ".tmp";
+}
+
+
+CLProgramCache::CLProgramCache()
+    : m_hits(0),
+    m_misses(0)
+{
+
+}
+
+void CLProgramCache::setCacheDir(std::string cache_dir)
+{
+    // strip the trailing separator, we add it back in getCachePath()
+    while ( !cache_dir.empty() && (cache_dir.back() == '/' || cache_dir.back() == '\\') )
+    {
+        cache_dir.pop_back();
+    }
+    m_cacheDir = cache_dir;
+}
+
+bool CLProgramCache::isEnabled() const
+{
+    return !m_cacheDir.empty();
+}
+
+cl_program CLProgramCache::load(cl_context context, cl_device_id device, const std::string& key, const std::string& build_options)
+{
+    if ( !isEnabled() )
+    {
+        return nullptr;
+    }
+
+    std::ifstream ifs(getCachePath(key), std::ios::binary);
+    std::vector<unsigned char> binary = ifs ?
+        std::vector<unsigned char>(std::istreambuf_iterator<char>(ifs), (std::istreambuf_iterator<char>())) :
+        std::vector<unsigned char>();
+
+    if ( binary.empty() )
+    {
+        m_misses++;
+        return nullptr;
+    }
+
+    cl_int error = CL_SUCCESS;
+    cl_int binary_status = CL_SUCCESS;
+    size_t binary_size = binary.size();
+    const unsigned char* binary_data = binary.data();
+    cl_program program = clCreateProgramWithBinary(context, 1, &device,
+        &binary_size, &binary_data, &binary_status, &error);
+
+    if ( error == CL_SUCCESS && binary_status == CL_SUCCESS )
+    {
+        // binaries still need to be built (linked) before creating kernels, but this skips the compilation.
+        error = clBuildProgram(program, 1, &device, build_options.c_str(), NULL, NULL);
+    }
+
+    if ( error != CL_SUCCESS || binary_status != CL_SUCCESS )
+    {
+        // stale binary (i.e. driver update), let the caller rebuild from source and overwrite it.
+        if ( program != nullptr )
+        {
+            clReleaseProgram(program);
+        }
+        m_misses++;
+        return nullptr;
+    }
+
+    m_hits++;
+    return program;
+}
+
+bool CLProgramCache::store(cl_program program, const std::string& key)
+{
+    if ( !isEnabled() )
+    {
+        return false;
+    }
+
+    size_t binary_size = 0;
+    cl_int error = clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binary_size, nullptr);
+    if ( error != CL_SUCCESS || binary_size == 0 )
+    {
+        return false;
+    }
+
+    std::vector<unsigned char> binary(binary_size);
+    unsigned char* binary_data = binary.data();
+    error = clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char*), &binary_data, nullptr);
+    if ( error != CL_SUCCESS )
+    {
+        return false;
+    }
+
+    // write into a temporary file of our own first, so that concurrent processes never read a partial binary
+    //  nor write into the same file. The entry is replaced at once, it is never missing.
+    std::string path = getCachePath(key);
+    std::string tmp_path = getTempPath(path);
+    bool is_written = false;
+    {
+        std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+        if ( !ofs )
+        {
+            std::cerr << "Unable to write program cache: " << tmp_path << '\n';
+            return false;
+        }
+        ofs.write(reinterpret_cast<const char*>(binary.data()), binary.size());
+        ofs.close();
+        is_written = !ofs.fail();
+    }
+
+    if ( !is_written || !replaceFile(tmp_path, path) )
+    {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+size_t CLProgramCache::getHits() const
+{
+    return m_hits;
+}
+
+size_t CLProgramCache::getMisses() const
+{
+    return m_misses;
+}
+
+std::string CLProgramCache::hash(const std::string& data)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for ( unsigned char c : data )
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    return hex;
+}
+
+std::string CLProgramCache::getCachePath(const std::string& key) const
+{
+    return m_cacheDir + "/" + key + ".clbin";
+}
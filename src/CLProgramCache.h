@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+#include "CLConfig.h"
+
+// On-disk cache of built program binaries (CL_PROGRAM_BINARIES).
+//  Each entry is stored as <cache_dir>/<key>.clbin, where key is a hash of everything that
+//  affects the compiled binary (source, build options, platform, device and driver version).
+//  The cache is disabled until a directory is set; the directory must already exist.
+class CLProgramCache
+{
+public:
+    CLProgramCache();
+
+    void setCacheDir(std::string cache_dir);    // empty string disables the cache
+
+    bool isEnabled() const;
+
+    // try to create and build a program from the cached binary.
+    //  returns nullptr on miss, or when the driver rejects the binary (caller should rebuild from source).
+    cl_program load(cl_context context, cl_device_id device, const std::string& key, const std::string& build_options);
+
+    // write the binary of a built (single device) program into the cache.
+    bool store(cl_program program, const std::string& key);
+
+    size_t getHits() const;
+
+    size_t getMisses() const;
+
+    // 64 bit FNV-1a hash, returned as hex string. Used to build the cache key.
+    static std::string hash(const std::string& data);
+
+private:
+    std::string getCachePath(const std::string& key) const;
+
+    std::string m_cacheDir;
+
+    size_t m_hits;
+    size_t m_misses;
+};
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "CLResidencyCache.h"
+
+
+CLResidencyCache::CLResidencyCache()
+    : m_deviceMemSize(0),
+    m_budget(0),
+    m_residentBytes(0),
+    m_hits(0),
+    m_misses(0),
+    m_bytesSaved(0),
+    m_bytesUploaded(0),
+    m_evictionCount(0)
+{
+
+}
+
+CLResidencyCache::~CLResidencyCache()
+{
+    clear();
+}
+
+void CLResidencyCache::setDeviceMemSize(size_t device_mem_size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_deviceMemSize = device_mem_size;
+    m_budget = device_mem_size / 4;     // the rest for the buffers of the wrappers
+    evict(0);
+}
+
+void CLResidencyCache::setBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget = (m_deviceMemSize > 0) ? std::min(bytes, m_deviceMemSize) : bytes;
+    evict(0);
+}
+
+size_t CLResidencyCache::getBudget() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_budget;
+}
+
+cl_mem CLResidencyCache::find(const std::string& key, size_t len)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto entry = m_entries.find(key);
+    if ( entry == m_entries.end() || entry->second.len != len )
+    {
+        m_misses++;
+        m_bytesUploaded += len;
+        return nullptr;
+    }
+
+    m_hits++;
+    m_bytesSaved += len;
+    m_lru.splice(m_lru.begin(), m_lru, entry->second.lru);
+    clRetainMemObject(entry->second.buffer);
+    return entry->second.buffer;
+}
+
+bool CLResidencyCache::insert(const std::string& key, cl_mem buffer, size_t len)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // i.e. two wrappers missed the same key at the same time: the last upload is kept
+    auto previous = m_entries.find(key);
+    if ( previous != m_entries.end() )
+    {
+        removeEntry(previous);
+    }
+    if ( len > m_budget )
+    {
+        return false;
+    }
+
+    evict(len);
+    clRetainMemObject(buffer);
+    m_lru.push_front(key);
+    m_entries[key] = Entry{ buffer, len, m_lru.begin() };
+    m_residentBytes += len;
+    return true;
+}
+
+void CLResidencyCache::remove(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto entry = m_entries.find(key);
+    if ( entry != m_entries.end() )
+    {
+        removeEntry(entry);
+    }
+}
+
+void CLResidencyCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while ( !m_entries.empty() )
+    {
+        removeEntry(m_entries.begin());
+    }
+}
+
+size_t CLResidencyCache::getResidentBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_residentBytes;
+}
+
+size_t CLResidencyCache::getHits() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hits;
+}
+
+size_t CLResidencyCache::getMisses() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_misses;
+}
+
+size_t CLResidencyCache::getBytesSaved() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytesSaved;
+}
+
+size_t CLResidencyCache::getBytesUploaded() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytesUploaded;
+}
+
+size_t CLResidencyCache::getEvictionCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_evictionCount;
+}
+
+std::string CLResidencyCache::hashContent(const void* data, size_t len)
+{
+    // four independent lanes of 64-bit words, so that hashing runs close to memory bandwidth
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    const uint64_t prime = 0x9E3779B97F4A7C15ULL;
+    uint64_t lanes[4] = { 1, 2, 3, 4 };
+    size_t i = 0;
+    for ( ; i + 32 <= len; i += 32 )
+    {
+        for ( int lane = 0; lane < 4; lane++ )
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes + i + lane * 8, sizeof(word));
+            lanes[lane] = (lanes[lane] ^ word) * prime;
+            lanes[lane] ^= lanes[lane] >> 29;
+        }
+    }
+
+    uint64_t hash = 14695981039346656037ULL;
+    for ( uint64_t lane : lanes )
+    {
+        hash = (hash ^ lane) * 1099511628211ULL;
+    }
+    for ( ; i < len; i++ )
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+
+    char key[40];
+    std::snprintf(key, sizeof(key), "%zu:%016llx", len, static_cast<unsigned long long>(hash));
+    return key;
+}
+
+void CLResidencyCache::evict(size_t bytes)
+{
+    while ( !m_lru.empty() && m_residentBytes + bytes > m_budget )
+    {
+        removeEntry(m_entries.find(m_lru.back()));
+        m_evictionCount++;
+    }
+}
+
+void CLResidencyCache::removeEntry(std::map<std::string, Entry>::iterator entry)
+{
+    clReleaseMemObject(entry->second.buffer);
+    m_residentBytes -= entry->second.len;
+    m_lru.erase(entry->second.lru);
+    m_entries.erase(entry);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "CLConfig.h"
+
+// Read-only device buffers kept across launches and wrappers, so that an input that doesn't change
+//  (i.e. the weights of a matrix multiply) is uploaded once instead of on every setKernelBufferArg().
+//  Entries are keyed by a caller tag or by the hash of their content (see hashContent()), and evicted in least
+//  recently used order to stay within a byte budget. Held by the session (see CLSession::getResidencyCache()),
+//  used through CLSimpleWrapper::setKernelResidentBufferArg(). Thread safe.
+class CLResidencyCache
+{
+public:
+    CLResidencyCache();
+    ~CLResidencyCache();
+
+    CLResidencyCache(const CLResidencyCache&) = delete;
+    CLResidencyCache& operator=(const CLResidencyCache&) = delete;
+
+    // CL_DEVICE_GLOBAL_MEM_SIZE of the smallest device, the budget is a quarter of it until setBudget().
+    void setDeviceMemSize(size_t device_mem_size);
+
+    // bytes kept resident at most, capped to the device memory. Lowering it evicts right away.
+    void setBudget(size_t bytes);
+
+    size_t getBudget() const;
+
+    // retained buffer of the key when it is resident with the same length (hit), nullptr otherwise (miss).
+    //  the caller releases it with clReleaseMemObject().
+    cl_mem find(const std::string& key, size_t len);
+
+    // keep the uploaded buffer of a miss (the cache retains it), evicting the least recently used entries to fit.
+    //  false when the buffer alone is larger than the budget, it is not kept.
+    bool insert(const std::string& key, cl_mem buffer, size_t len);
+
+    // drop the entry, i.e. the content of its tag changed. Wrappers using the buffer keep it until they release it.
+    void remove(const std::string& key);
+
+    void clear();
+
+    size_t getResidentBytes() const;
+
+    size_t getHits() const;
+
+    size_t getMisses() const;
+
+    // bytes not uploaded thanks to the hits, and bytes uploaded for the misses.
+    size_t getBytesSaved() const;
+
+    size_t getBytesUploaded() const;
+
+    size_t getEvictionCount() const;
+
+    // key of the content: length and a 64-bit hash, computed 8 bytes at a time. Not cryptographic: a collision
+    //  (unlikely, but possible for crafted data) finds the buffer of the other content.
+    static std::string hashContent(const void* data, size_t len);
+
+private:
+    struct Entry
+    {
+        cl_mem buffer;
+        size_t len;
+        std::list<std::string>::iterator lru;   // position in m_lru
+    };
+
+    // evict the least recently used entries until bytes more fit in the budget, the mutex must be held.
+    void evict(size_t bytes);
+
+    void removeEntry(std::map<std::string, Entry>::iterator entry);
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Entry> m_entries;
+    std::list<std::string> m_lru;   // most recently used first
+
+    size_t m_deviceMemSize;
+    size_t m_budget;
+    size_t m_residentBytes;
+    size_t m_hits;
+    size_t m_misses;
+    size_t m_bytesSaved;
+    size_t m_bytesUploaded;
+    size_t m_evictionCount;
+};
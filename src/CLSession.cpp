@@ -0,0 +1,488 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "CLSession.h"
+#include "CLSimpleWrapper.h"
+
+
+std::mutex CLSession::s_enumMutex;
+std::mutex CLSession::s_sharedMutex;
+bool CLSession::s_verbose = false;
+std::vector<cl_platform_id> CLSession::s_platformIds;
+std::map<std::pair<cl_platform_id, cl_device_type>, std::vector<cl_device_id> > CLSession::s_deviceIds;
+std::map<CLSession::SharedKey, std::shared_ptr<CLSession> > CLSession::s_sharedSessions;
+
+CLSession::CLSession()
+    : m_context(nullptr),
+    m_queueProperties(0),
+    m_nextPoolQueue(0)
+{
+
+}
+
+CLSession::~CLSession()
+{
+    // the workers use the context
+    for ( auto& build : m_pendingBuilds )
+    {
+        build.second.wait();
+    }
+    m_pendingBuilds.clear();
+
+    for ( auto& program : m_programs )
+    {
+        clReleaseProgram(program.second);
+    }
+    m_programs.clear();
+
+    for ( cl_command_queue queue : m_transferQueues )
+    {
+        clFinish(queue);
+        clReleaseCommandQueue(queue);
+    }
+    m_transferQueues.clear();
+
+    for ( cl_command_queue queue : m_poolQueues )
+    {
+        clFinish(queue);
+        clReleaseCommandQueue(queue);
+    }
+    m_poolQueues.clear();
+
+    for ( cl_command_queue queue : m_cmdQueues )
+    {
+        clFinish(queue);
+        clReleaseCommandQueue(queue);
+    }
+    m_cmdQueues.clear();
+
+    m_residencyCache.clear();
+    if ( nullptr != m_context )
+    {
+        clReleaseContext(m_context);
+    }
+}
+
+std::shared_ptr<CLSession> CLSession::create(int platformId, int deviceId, cl_command_queue_properties properties)
+{
+    std::shared_ptr<CLSession> session(new CLSession());
+
+    std::vector<cl_platform_id> platformIds = getPlatformIds();
+    if ( platformIds.empty() || platformId >= (int)platformIds.size() )
+    {
+        std::cerr << "No OpenCL platform found" << '\n';
+        return session;
+    }
+    cl_platform_id platform = platformIds[platformId < 0 ? 0 : platformId];
+
+    std::vector<cl_device_id> deviceIds = getDeviceIds(platform);
+    if ( deviceIds.empty() || deviceId >= (int)deviceIds.size() )
+    {
+        std::cerr << "No OpenCL devices found" << '\n';
+        return session;
+    }
+    session->m_devices.push_back(deviceIds[deviceId < 0 ? 0 : deviceId]);
+
+    session->createContext(platform, properties);
+    return session;
+}
+
+std::shared_ptr<CLSession> CLSession::createMultiDevice(int platformId, cl_device_type device_type, cl_command_queue_properties properties)
+{
+    std::shared_ptr<CLSession> session(new CLSession());
+
+    std::vector<cl_platform_id> platformIds = getPlatformIds();
+    if ( platformIds.empty() || platformId >= (int)platformIds.size() )
+    {
+        std::cerr << "No OpenCL platform found" << '\n';
+        return session;
+    }
+    cl_platform_id platform = platformIds[platformId < 0 ? 0 : platformId];
+
+    session->m_devices = getDeviceIds(platform, device_type);
+    if ( session->m_devices.empty() )
+    {
+        std::cerr << "No OpenCL devices found" << '\n';
+        return session;
+    }
+
+    session->createContext(platform, properties);
+    return session;
+}
+
+std::shared_ptr<CLSession> CLSession::createEmpty()
+{
+    return std::shared_ptr<CLSession>(new CLSession());
+}
+
+std::shared_ptr<CLSession> CLSession::getShared(int platformId, int deviceId, cl_command_queue_properties properties)
+{
+    std::lock_guard<std::mutex> lock(s_sharedMutex);
+
+    SharedKey key(platformId, deviceId, properties);
+    auto shared = s_sharedSessions.find(key);
+    if ( shared != s_sharedSessions.end() )
+    {
+        return shared->second;
+    }
+
+    std::shared_ptr<CLSession> session = create(platformId, deviceId, properties);
+    s_sharedSessions[key] = session;
+    return session;
+}
+
+void CLSession::releaseShared()
+{
+    std::lock_guard<std::mutex> lock(s_sharedMutex);
+    s_sharedSessions.clear();
+}
+
+void CLSession::setVerbose(bool verbose)
+{
+    s_verbose = verbose;
+}
+
+bool CLSession::isVerbose()
+{
+    return s_verbose;
+}
+
+void CLSession::listDevices()
+{
+    std::vector<cl_platform_id> platformIds = getPlatformIds();
+    if ( platformIds.empty() )
+    {
+        std::cerr << "No OpenCL platform found" << '\n';
+        return;
+    }
+    std::cout << "Found " << platformIds.size() << " platform(s)" << '\n';
+
+    // print all the platform and devices
+    for ( size_t i = 0; i < platformIds.size(); ++i )
+    {
+        std::cout << "\t" << i << ". Platform Name : " << getPlatformName(platformIds[i]) << '\n';
+
+        std::vector<cl_device_id> deviceIds = getDeviceIds(platformIds[i]);
+        if ( deviceIds.empty() )
+        {
+            std::cerr << "No OpenCL devices found" << '\n';
+            continue;
+        }
+        std::cout << "Found " << deviceIds.size() << " device(s)" << '\n';
+
+        for ( size_t j = 0; j < deviceIds.size(); j++ )
+        {
+            std::cout << "\t\t" << i << "." << j << " Device Name : " << getDeviceName(deviceIds[j]) << '\n';
+        }
+    }
+    std::cout.flush();
+}
+
+std::vector<cl_platform_id> CLSession::getPlatformIds()
+{
+    std::lock_guard<std::mutex> lock(s_enumMutex);
+
+    if ( s_platformIds.empty() )
+    {
+        cl_uint platformIdCount = 0;
+        clGetPlatformIDs(0, nullptr, &platformIdCount);
+        if ( platformIdCount > 0 )
+        {
+            s_platformIds.resize(platformIdCount);
+            clGetPlatformIDs(platformIdCount, s_platformIds.data(), nullptr);
+        }
+    }
+    return s_platformIds;
+}
+
+std::vector<cl_device_id> CLSession::getDeviceIds(cl_platform_id platform, cl_device_type device_type)
+{
+    std::lock_guard<std::mutex> lock(s_enumMutex);
+
+    auto key = std::make_pair(platform, device_type);
+    auto cached = s_deviceIds.find(key);
+    if ( cached != s_deviceIds.end() )
+    {
+        return cached->second;
+    }
+
+    cl_uint deviceIdCount = 0;
+    clGetDeviceIDs(platform, device_type, 0, nullptr, &deviceIdCount);
+
+    std::vector<cl_device_id> deviceIds(deviceIdCount);
+    if ( deviceIdCount > 0 )
+    {
+        clGetDeviceIDs(platform, device_type, deviceIdCount, deviceIds.data(), nullptr);
+    }
+    s_deviceIds[key] = deviceIds;
+    return deviceIds;
+}
+
+std::string CLSession::getPlatformName(cl_platform_id id)
+{
+    size_t size = 0;
+    clGetPlatformInfo(id, CL_PLATFORM_NAME, 0, nullptr, &size);
+
+    std::string result;
+    result.resize(size);
+    clGetPlatformInfo(id, CL_PLATFORM_NAME, size,
+        const_cast<char*> (result.data()), nullptr);
+    result.resize(std::strlen(result.c_str()));     // drop the terminating null character
+
+    return result;
+}
+
+std::string CLSession::getDeviceName(cl_device_id id)
+{
+    return getDeviceInfoString(id, CL_DEVICE_NAME);
+}
+
+std::string CLSession::getDeviceInfoString(cl_device_id id, cl_device_info param)
+{
+    size_t size = 0;
+    clGetDeviceInfo(id, param, 0, nullptr, &size);
+
+    std::string result;
+    result.resize(size);
+    clGetDeviceInfo(id, param, size,
+        const_cast<char*> (result.data()), nullptr);
+    result.resize(std::strlen(result.c_str()));     // drop the terminating null character
+
+    return result;
+}
+
+std::string CLSession::getDeviceSignature(cl_platform_id platform, cl_device_id device)
+{
+    // binaries are only valid for the exact same device and driver, a driver update invalidates the cache entries.
+    std::string signature;
+    signature += getPlatformName(platform) + '\0';
+    signature += getDeviceName(device) + '\0';
+    signature += getDeviceInfoString(device, CL_DEVICE_VERSION) + '\0';
+    signature += getDeviceInfoString(device, CL_DRIVER_VERSION) + '\0';
+    return signature;
+}
+
+bool CLSession::isValid() const
+{
+    return nullptr != m_context;
+}
+
+cl_context CLSession::getContext() const
+{
+    return m_context;
+}
+
+cl_device_id CLSession::getDevice() const
+{
+    return m_devices.empty() ? nullptr : m_devices[0];
+}
+
+cl_command_queue CLSession::getCommandQueue() const
+{
+    return m_cmdQueues.empty() ? nullptr : m_cmdQueues[0];
+}
+
+const std::vector<cl_device_id>& CLSession::getDevices() const
+{
+    return m_devices;
+}
+
+const std::vector<cl_command_queue>& CLSession::getCommandQueues() const
+{
+    return m_cmdQueues;
+}
+
+cl_command_queue_properties CLSession::getQueueProperties() const
+{
+    return m_queueProperties;
+}
+
+cl_int CLSession::createQueuePool(size_t count, cl_command_queue_properties properties)
+{
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+
+    for ( size_t i = 0; i < count; i++ )
+    {
+        cl_int error = CL_SUCCESS;
+        cl_command_queue queue = clCreateCommandQueue(m_context, m_devices[0], m_queueProperties | properties, &error);
+        if ( error != CL_SUCCESS )
+        {
+            return error;   // i.e. CL_INVALID_QUEUE_PROPERTIES, out-of-order execution not supported by the device
+        }
+        m_poolQueues.push_back(queue);
+    }
+    return CL_SUCCESS;
+}
+
+cl_command_queue CLSession::acquireQueue()
+{
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+
+    if ( m_poolQueues.empty() )
+    {
+        return m_cmdQueues[0];
+    }
+    return m_poolQueues[m_nextPoolQueue++ % m_poolQueues.size()];
+}
+
+cl_command_queue CLSession::getTransferQueue(size_t index)
+{
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+
+    while ( m_transferQueues.size() <= index )
+    {
+        cl_int error = CL_SUCCESS;
+        cl_command_queue queue = clCreateCommandQueue(m_context, m_devices[0], m_queueProperties, &error);
+        CLSimpleWrapper::checkCLError(error, "Fail to create command queue");
+        m_transferQueues.push_back(queue);
+    }
+    return m_transferQueues[index];
+}
+
+const std::string& CLSession::getDeviceSignature() const
+{
+    return m_deviceSignature;
+}
+
+CLResidencyCache& CLSession::getResidencyCache()
+{
+    return m_residencyCache;
+}
+
+cl_program CLSession::findProgram(const std::string& key)
+{
+    std::unique_lock<std::mutex> lock(m_programMutex);
+
+    auto build = m_pendingBuilds.find(key);
+    if ( build != m_pendingBuilds.end() )
+    {
+        // the worker adds the program under the lock, wait without holding it
+        std::shared_future<cl_int> pending = build->second;
+        lock.unlock();
+        pending.wait();
+        lock.lock();
+        m_pendingBuilds.erase(key);
+    }
+
+    auto program = m_programs.find(key);
+    if ( program == m_programs.end() )
+    {
+        return nullptr;
+    }
+
+    clRetainProgram(program->second);   // caller releases its own reference
+    return program->second;
+}
+
+void CLSession::addProgram(const std::string& key, cl_program program)
+{
+    std::lock_guard<std::mutex> lock(m_programMutex);
+
+    auto existing = m_programs.find(key);
+    if ( existing != m_programs.end() )
+    {
+        clReleaseProgram(existing->second);
+    }
+
+    clRetainProgram(program);
+    m_programs[key] = program;
+}
+
+std::shared_future<cl_int> CLSession::buildProgramAsync(const std::string& key, const std::string& source,
+    const std::string& build_options, std::function<void(cl_program)> on_built)
+{
+    std::lock_guard<std::mutex> lock(m_programMutex);
+
+    auto build = m_pendingBuilds.find(key);
+    if ( build != m_pendingBuilds.end() )
+    {
+        return build->second;
+    }
+    if ( m_programs.find(key) != m_programs.end() )
+    {
+        std::promise<cl_int> done;
+        done.set_value(CL_SUCCESS);
+        return done.get_future().share();
+    }
+
+    // OpenCL calls are thread safe, except clSetKernelArg() which is not used here
+    std::shared_future<cl_int> pending = std::async(std::launch::async, [this, key, source, build_options, on_built]()
+        {
+            cl_int error = CL_SUCCESS;
+            const char* src = source.c_str();
+            cl_program program = clCreateProgramWithSource(m_context, 1, &src, NULL, &error);
+            if ( CL_SUCCESS != error )
+            {
+                return error;
+            }
+
+            error = clBuildProgram(program, (cl_uint)m_devices.size(), m_devices.data(), build_options.c_str(), NULL, NULL);
+            if ( CL_SUCCESS == error )
+            {
+                if ( on_built )
+                {
+                    on_built(program);
+                }
+                addProgram(key, program);
+            }
+            clReleaseProgram(program);
+            return error;
+        }).share();
+    m_pendingBuilds[key] = pending;
+    return pending;
+}
+
+void CLSession::createContext(cl_platform_id platform, cl_command_queue_properties properties)
+{
+    cl_int error = CL_SUCCESS;
+
+    if ( s_verbose )
+    {
+        std::cout << "\t Selected Platform Name : " << getPlatformName(platform) << '\n';
+    }
+
+    const cl_context_properties contextProperties[] =
+    {
+        CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties> (platform),
+        0, 0
+    };
+
+    m_context = clCreateContext(contextProperties, (cl_uint)m_devices.size(),
+        m_devices.data(), nullptr, nullptr, &error);
+    CLSimpleWrapper::checkCLError(error, "Create Context Failed");
+    if ( s_verbose )
+    {
+        std::cout << "Context created" << '\n';
+    }
+
+    m_queueProperties = properties;
+    for ( cl_device_id device : m_devices )
+    {
+        if ( s_verbose )
+        {
+            std::cout << "\t Selected Device Name : " << getDeviceName(device) << '\n';
+        }
+
+        cl_command_queue queue = clCreateCommandQueue(m_context, device, properties, &error);
+        CLSimpleWrapper::checkCLError(error, "Fail to create command queue");
+        m_cmdQueues.push_back(queue);
+
+        m_deviceSignature += getDeviceSignature(platform, device);
+    }
+
+    // resident buffers are allocated on every device of the context, the smallest one bounds the budget
+    cl_ulong device_mem_size = 0;
+    for ( cl_device_id device : m_devices )
+    {
+        cl_ulong mem_size = 0;
+        clGetDeviceInfo(device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(cl_ulong), &mem_size, nullptr);
+        device_mem_size = (0 == device_mem_size) ? mem_size : std::min(device_mem_size, mem_size);
+    }
+    m_residencyCache.setDeviceMemSize((size_t)device_mem_size);
+
+    if ( s_verbose )
+    {
+        std::cout << "Command Queue created" << '\n';
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <tuple>
+
+#include "CLConfig.h"
+#include "CLResidencyCache.h"
+
+// Long-lived OpenCL context, device(s) and command queue(s), shared by many CLSimpleWrapper instances.
+//  Creating the session enumerates the devices (cached for the whole process), creates the context and the queues once;
+//  a wrapper attached to an existing session only pays for its kernel arguments and the enqueue.
+//  Programs built by the wrappers are kept in the session too, so the same source is built once per session.
+class CLSession
+{
+public:
+    ~CLSession();
+
+    // session on a single device, -1 selects the first platform / device.
+    static std::shared_ptr<CLSession> create(int platformId = -1, int deviceId = -1,
+        cl_command_queue_properties properties = 0);
+
+    // session over every device of device_type in the platform, with one queue per device.
+    static std::shared_ptr<CLSession> createMultiDevice(int platformId = -1,
+        cl_device_type device_type = CL_DEVICE_TYPE_ALL, cl_command_queue_properties properties = 0);
+
+    // session without context nor device, isValid() is false. i.e. when no device suits a selection.
+    static std::shared_ptr<CLSession> createEmpty();
+
+    // process wide session, created on first use and reused by every caller with the same arguments.
+    static std::shared_ptr<CLSession> getShared(int platformId = -1, int deviceId = -1,
+        cl_command_queue_properties properties = 0);
+
+    // drop the process wide sessions, they are released once the last wrapper using them is gone.
+    static void releaseShared();
+
+    // logging is silent by default, except listDevices().
+    static void setVerbose(bool verbose);
+
+    static bool isVerbose();
+
+    // print every platform and device.
+    static void listDevices();
+
+    // enumeration is done once per process and cached.
+    static std::vector<cl_platform_id> getPlatformIds();
+
+    static std::vector<cl_device_id> getDeviceIds(cl_platform_id platform, cl_device_type device_type = CL_DEVICE_TYPE_ALL);
+
+    static std::string getPlatformName(cl_platform_id id);
+
+    static std::string getDeviceName(cl_device_id id);
+
+    static std::string getDeviceInfoString(cl_device_id id, cl_device_info param);
+
+    // platform, device names and driver version of a device, identifies the device across runs.
+    static std::string getDeviceSignature(cl_platform_id platform, cl_device_id device);
+
+    // false when no platform or device was found.
+    bool isValid() const;
+
+    cl_context getContext() const;
+
+    cl_device_id getDevice() const;     // first device
+
+    cl_command_queue getCommandQueue() const;   // queue of the first device
+
+    const std::vector<cl_device_id>& getDevices() const;
+
+    const std::vector<cl_command_queue>& getCommandQueues() const;
+
+    cl_command_queue_properties getQueueProperties() const;
+
+    // add count queues on the first device to the pool, with the session properties plus properties
+    //  (i.e. CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE). Wrappers attached afterward take one each round-robin,
+    //  so that wrappers driven by different host threads don't submit into the same queue.
+    cl_int createQueuePool(size_t count, cl_command_queue_properties properties = 0);
+
+    // next queue of the pool, or the queue of the first device when there is no pool.
+    cl_command_queue acquireQueue();
+
+    // additional queue of the first device, created on first use with the same properties.
+    //  commands of different in-order queues may run concurrently, i.e. transfers overlapping the kernels.
+    cl_command_queue getTransferQueue(size_t index);
+
+    // platform, device names and driver versions of the session devices, part of the program cache key.
+    const std::string& getDeviceSignature() const;
+
+    // built programs shared by the wrappers of this session. findProgram() returns a retained program or nullptr,
+    //  it waits for a background build of the same key when there is one.
+    cl_program findProgram(const std::string& key);
+
+    void addProgram(const std::string& key, cl_program program);
+
+    // build the program on a worker thread into the program map, on_built is called on that thread with the program
+    //  once it is built (i.e. to store the binary). The build of a key already built or being built is not started again.
+    std::shared_future<cl_int> buildProgramAsync(const std::string& key, const std::string& source,
+        const std::string& build_options, std::function<void(cl_program)> on_built = nullptr);
+
+    // device resident read-only inputs shared by the wrappers of this session, see setKernelResidentBufferArg().
+    CLResidencyCache& getResidencyCache();
+
+private:
+    CLSession();
+
+    // create context and one queue per device, devices must be set.
+    void createContext(cl_platform_id platform, cl_command_queue_properties properties);
+
+    cl_context m_context;
+    std::vector<cl_device_id> m_devices;
+    std::vector<cl_command_queue> m_cmdQueues;
+    cl_command_queue_properties m_queueProperties;
+    std::string m_deviceSignature;
+
+    std::mutex m_queueMutex;   // guards the transfer queues and the queue pool
+    std::vector<cl_command_queue> m_transferQueues;
+    std::vector<cl_command_queue> m_poolQueues;
+    size_t m_nextPoolQueue;
+
+    std::mutex m_programMutex;
+    std::map<std::string, cl_program> m_programs;
+    std::map<std::string, std::shared_future<cl_int> > m_pendingBuilds;   // background builds, kept until waited
+
+    CLResidencyCache m_residencyCache;
+
+    typedef std::tuple<int, int, cl_command_queue_properties> SharedKey;   // (platform, device, properties)
+
+    static std::mutex s_enumMutex;      // guards the device enumeration cache
+    static std::mutex s_sharedMutex;    // guards the process wide sessions
+    static bool s_verbose;
+    static std::vector<cl_platform_id> s_platformIds;
+    static std::map<std::pair<cl_platform_id, cl_device_type>, std::vector<cl_device_id> > s_deviceIds;
+    static std::map<SharedKey, std::shared_ptr<CLSession> > s_sharedSessions;
+};
@@ -5,21 +5,39 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <algorithm>
+#include <chrono>
 #include <stdlib.h> 
+#include <cstring>
+#include <cstdint>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 
 #include "CLSimpleWrapper.h"
+#include "CLMappedFile.h"
 
 
 CLSimpleWrapper::CLSimpleWrapper()
     : m_device(nullptr),
     m_context(nullptr),
     m_kernel(nullptr),
-    m_program(nullptr),
-    m_cmdQueue(nullptr)
+    m_cmdQueue(nullptr),
+    m_isOutOfOrder(false),
+    m_splitPolicy(SplitPolicy::Static),
+    m_bufferMode(BufferMode::Copy),
+    m_isAutotuneEnabled(false),
+    m_recording(nullptr)
 {
 
 }
 
+CLSimpleWrapper::CLSimpleWrapper(std::shared_ptr<CLSession> session)
+    : CLSimpleWrapper()
+{
+    attachSession(session);
+}
+
 CLSimpleWrapper::~CLSimpleWrapper()
 {
     clear();
@@ -27,266 +45,1710 @@ CLSimpleWrapper::~CLSimpleWrapper()
 
 void CLSimpleWrapper::initOpenCL(int platformId, int deviceId, bool is_list_only)
 {
-    cl_int error = CL_SUCCESS;
-    cl_uint platformIdCount = 0;
-    std::vector<cl_device_id> deviceIds;	// init: empty result
-    error = clGetPlatformIDs(0, nullptr, &platformIdCount);
-
-    if ( platformIdCount == 0 )
+    if ( is_list_only )
     {
-        std::cerr << "No OpenCL platform found" << std::endl;
+        // list only, without selecting platform and device, return empty device
+        CLSession::listDevices();
         return;
     }
-    else
+
+    attachSession(CLSession::create(platformId, deviceId,
+        m_profiler.isEnabled() ? CL_QUEUE_PROFILING_ENABLE : 0));
+}
+
+void CLSimpleWrapper::initOpenCLMultiDevice(int platformId, cl_device_type device_type)
+{
+    // profiling is always enabled here, the kernel times drive the throughput split policy.
+    attachSession(CLSession::createMultiDevice(platformId, device_type, CL_QUEUE_PROFILING_ENABLE));
+}
+
+size_t CLSimpleWrapper::getDeviceCount() const
+{
+    return m_devices.size();
+}
+
+std::shared_ptr<CLSession> CLSimpleWrapper::getSession() const
+{
+    return m_session;
+}
+
+std::unique_ptr<CLSimpleWrapper> CLSimpleWrapper::clone() const
+{
+    std::unique_ptr<CLSimpleWrapper> wrapper(new CLSimpleWrapper());
+    wrapper->m_profiler.setEnabled(m_profiler.isEnabled());
+    wrapper->m_bufferMode = m_bufferMode;
+    if ( nullptr == m_session )
     {
-        std::cout << "Found " << platformIdCount << " platform(s)" << std::endl;
+        return wrapper;
     }
 
-    if ( 0 == platformIdCount )
+    wrapper->attachSession(m_session);
+    wrapper->m_splitPolicy = m_splitPolicy;
+    wrapper->m_splitRatios = m_splitRatios;
+
+    // new kernel instances of the same programs, kernel arguments are per instance.
+    for ( cl_program program : m_programs )
     {
-        std::cerr << "No openCL Platform! " << std::endl;
-        std::exit(1);
+        clRetainProgram(program);
+        wrapper->m_programs.push_back(program);
+        wrapper->createKernels(program);
+    }
+    for ( const auto& variant : m_variants )
+    {
+        cl_int error = CL_SUCCESS;
+        KernelVariant kernel_variant = variant.second;
+        kernel_variant.kernel = clCreateKernel(kernel_variant.program, kernel_variant.function_name.c_str(), &error);
+        checkCLError(error, "Create Kernel Failed");
+        clRetainProgram(kernel_variant.program);
+        wrapper->m_variants[variant.first] = kernel_variant;
+    }
+
+    wrapper->selectKernel(m_kernelName);
+    for ( const auto& variant : wrapper->m_variants )
+    {
+        if ( variant.second.name == m_kernelName )  // the current kernel is a variant
+        {
+            wrapper->m_kernel = variant.second.kernel;
+            wrapper->m_kernelName = m_kernelName;
+        }
+    }
+
+    return wrapper;
+}
+
+void CLSimpleWrapper::attachSession(std::shared_ptr<CLSession> session)
+{
+    m_session = session;
+    if ( !m_session->isValid() )
+    {
+        return;
     }
 
-    // first get all the platforms
-    std::vector<cl_platform_id> platformIds(platformIdCount);
-    error = clGetPlatformIDs(platformIdCount, platformIds.data(), nullptr);
+    m_context = m_session->getContext();
+    m_device = m_session->getDevice();
+    m_cmdQueue = m_session->acquireQueue();
+    m_devices = m_session->getDevices();
+    m_cmdQueues = m_session->getCommandQueues();
+
+    cl_command_queue_properties properties = 0;
+    clGetCommandQueueInfo(m_cmdQueue, CL_QUEUE_PROPERTIES, sizeof(properties), &properties, nullptr);
+    m_isOutOfOrder = (0 != (properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE));
+
+    m_bufferPool.setContext(m_context);
+    m_splitRatios.assign(m_devices.size(), 1.0 / m_devices.size());
+}
+
+cl_int CLSimpleWrapper::buildProgram(std::string& kernel_source_str, const std::string& prog_name,
+    const std::string& build_options, cl_program& program)
+{
+    cl_int error = CL_SUCCESS;
+    bool is_cached = false;
+    program = nullptr;
 
-    // print all the platform and devices
-    for ( cl_uint i = 0; i < platformIdCount; ++i )
+    if ( nullptr == m_session || !m_session->isValid() )
     {
-        std::cout << "\t" << i << ". Platform Name : " << GetPlatformName(platformIds[i]) << std::endl;
+        return CL_INVALID_CONTEXT;  // initOpenCL() not called, or no device found
+    }
 
-        cl_uint deviceIdCount = 0;
-        error = clGetDeviceIDs(platformIds[i], CL_DEVICE_TYPE_ALL, 0, nullptr,
-            &deviceIdCount);
-        if ( deviceIdCount == 0 )
+    auto build_start = std::chrono::steady_clock::now();
+
+    // the cache holds single device binaries, multi-device contexts always build from source.
+    bool use_cache = m_programCache.isEnabled() && m_devices.size() <= 1;
+
+    // same source already built within the session, i.e. by another wrapper
+    std::string cache_key = getProgramCacheKey(kernel_source_str, build_options);
+    program = m_session->findProgram(cache_key);
+    is_cached = (nullptr != program);
+
+    if ( nullptr == program && use_cache )
+    {
+        program = m_programCache.load(m_context, m_device, cache_key, build_options);
+        is_cached = (nullptr != program);
+        if ( is_cached )
         {
-            std::cerr << "No OpenCL devices found" << std::endl;
-            return;
+            m_session->addProgram(cache_key, program);
         }
-        else
+    }
+
+    if ( nullptr == program )
+    {
+        const char* src = kernel_source_str.c_str();
+        program = clCreateProgramWithSource(m_context, 1,
+            &src, NULL, &error);
+        if ( error != CL_SUCCESS )
         {
-            std::cout << "Found " << deviceIdCount << " device(s)" << std::endl;
+            size_t len;
+            char buffer[2048];
+            clGetProgramBuildInfo(program, m_device,
+                CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, &len);
+            std::cout << "Build Error: " << buffer << std::endl;
+            clReleaseProgram(program);  // do we need to clear?
+            return error;
         }
 
-        std::vector<cl_device_id> deviceIds(deviceIdCount);
-        error = clGetDeviceIDs(platformIds[i], CL_DEVICE_TYPE_ALL, deviceIdCount,
-            deviceIds.data(), nullptr);
+        error = clBuildProgram(program, (cl_uint)m_devices.size(), m_devices.data(), build_options.c_str(), NULL, NULL);
+        checkCLError(error, "Program Build Failed");
 
-        for ( int j = 0; j < deviceIdCount; j++ )
+        if ( use_cache )
         {
-            std::string deviceName = GetDeviceName(deviceIds[j]);
-            std::cout << "\t\t" << i << "." << j << " Device Name : " << deviceName << std::endl;
+            m_programCache.store(program, cache_key);
         }
+        m_session->addProgram(cache_key, program);
     }
+    m_profiler.recordHost(prog_name, is_cached ? "build (cached)" : "build", build_start, std::chrono::steady_clock::now());
 
-    if ( is_list_only )
+    return CL_SUCCESS;
+}
+
+
+cl_int CLSimpleWrapper::createCLKernel(std::string& kernel_source_str, std::string prog_name, std::string build_options)
+{
+    ensureKernels();    // keep the call order of createCLKernelAsync()
+
+    cl_program program = nullptr;
+    cl_int error = buildProgram(kernel_source_str, prog_name, build_options, program);
+    if ( error != CL_SUCCESS )
     {
-        // list only, without selecting platform and device, return empty device
-        return;
+        return error;
+    }
+    m_programs.push_back(program);
+
+    // create all the kernels at once, so that every stage of a pipeline shares this build.
+    createKernels(program);
+
+    error = selectKernel(prog_name);
+    checkCLError(error, "Create Kernel Failed");
+
+    return error;
+}
+
+CLBuildHandle CLSimpleWrapper::createCLKernelAsync(std::string kernel_source_str, std::string prog_name, std::string build_options)
+{
+    CLBuildHandle handle = startBuild(kernel_source_str, build_options);
+    if ( !handle.isReady() || CL_SUCCESS == handle.wait() )
+    {
+        m_pendingKernels.push_back(PendingKernel{ kernel_source_str, prog_name, build_options, handle });
     }
+    return handle;
+}
 
-    // select platform
-    cl_platform_id platform;
-    if ( platformId < 0 )
+std::vector<CLBuildHandle> CLSimpleWrapper::prebuildCLKernels(const std::vector<CLProgramSource>& programs)
+{
+    std::vector<CLBuildHandle> handles;
+    for ( const CLProgramSource& program : programs )
     {
-        platform = platformIds[0];	// get the first platform.
+        handles.push_back(startBuild(program.source, program.build_options));
     }
-    else
+    return handles;
+}
+
+CLBuildHandle CLSimpleWrapper::startBuild(const std::string& kernel_source_str, const std::string& build_options)
+{
+    if ( nullptr == m_session || !m_session->isValid() )
     {
-        platform = platformIds[platformId];
+        return CLBuildHandle(CL_INVALID_CONTEXT);
     }
 
-    const cl_context_properties contextProperties[] =
+    // the binary cache is fast enough to be loaded on the caller thread, like in buildProgram()
+    std::string cache_key = getProgramCacheKey(kernel_source_str, build_options);
+    bool use_cache = m_programCache.isEnabled() && m_devices.size() <= 1;
+    if ( use_cache )
     {
-        CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties> (platformIds[platformId]),
-        0, 0
-    };
+        cl_program program = m_session->findProgram(cache_key);
+        if ( nullptr == program )
+        {
+            program = m_programCache.load(m_context, m_device, cache_key, build_options);
+            if ( nullptr != program )
+            {
+                m_session->addProgram(cache_key, program);
+            }
+        }
+        if ( nullptr != program )
+        {
+            clReleaseProgram(program);
+            return CLBuildHandle(CL_SUCCESS);
+        }
+    }
+
+    std::function<void(cl_program)> on_built;
+    if ( use_cache )
+    {
+        CLProgramCache cache = m_programCache;  // store() only reads the cache directory
+        on_built = [cache, cache_key](cl_program program) mutable
+        {
+            cache.store(program, cache_key);
+        };
+    }
+    return CLBuildHandle(m_session->buildProgramAsync(cache_key, kernel_source_str, build_options, on_built));
+}
 
-    std::string platformName = GetPlatformName(platform);
-    std::cout << "\t Selected Platform Name : " << platformName << std::endl;
+cl_int CLSimpleWrapper::ensureKernels()
+{
+    cl_int result = CL_SUCCESS;
+    if ( m_pendingKernels.empty() )
+    {
+        return result;
+    }
 
-    // select device
-    cl_uint deviceIdCount = 0;
-    error = clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, 0, nullptr,
-        &deviceIdCount);
+    std::vector<PendingKernel> pending;
+    pending.swap(m_pendingKernels);
+    for ( PendingKernel& kernel : pending )
+    {
+        // the program is found in the session once the worker is done, a failed build is not built again
+        cl_program program = nullptr;
+        cl_int error = kernel.build.wait();
+        if ( CL_SUCCESS == error )
+        {
+            error = buildProgram(kernel.source, kernel.prog_name, kernel.build_options, program);
+        }
+        if ( CL_SUCCESS == error )
+        {
+            m_programs.push_back(program);
+            createKernels(program);
+            error = selectKernel(kernel.prog_name);
+        }
+        if ( CL_SUCCESS == result )
+        {
+            result = error;
+        }
+    }
+    return result;
+}
 
-    deviceIds.resize(deviceIdCount);	// allocate the space in vector, clGetDeviceIDs() take in as pointer.
-    error = clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, deviceIdCount,
-        deviceIds.data(), nullptr);
+cl_int CLSimpleWrapper::selectKernelVariant(std::string& kernel_source_str, std::string prog_name, std::string build_options)
+{
+    cl_int error = CL_SUCCESS;
 
-    if ( deviceId < 0 )
+    // the source is hashed once, then known by its address and size
+    std::string& source_hash = m_sourceHashes[std::make_pair(kernel_source_str.data(), kernel_source_str.size())];
+    if ( source_hash.empty() )
     {
-        m_device = deviceIds[0];	// get the first device.
+        source_hash = CLProgramCache::hash(kernel_source_str);
     }
-    else
+
+    std::string variant_key = prog_name + '\0' + build_options + '\0' + source_hash;
+    auto variant = m_variants.find(variant_key);
+    if ( variant == m_variants.end() )
     {
-        m_device = deviceIds[deviceId];
+        KernelVariant kernel_variant;
+        error = buildProgram(kernel_source_str, prog_name, build_options, kernel_variant.program);
+        if ( error != CL_SUCCESS )
+        {
+            return error;
+        }
+
+        kernel_variant.kernel = clCreateKernel(kernel_variant.program, prog_name.c_str(), &error);
+        if ( error != CL_SUCCESS )
+        {
+            clReleaseProgram(kernel_variant.program);
+            return error;
+        }
+
+        // own name per variant, for the profiler and the tuning file keys (no spaces)
+        kernel_variant.function_name = prog_name;
+        kernel_variant.name = prog_name + "#" + CLProgramCache::hash(source_hash + '\0' + build_options);
+        variant = m_variants.insert(std::make_pair(variant_key, kernel_variant)).first;
     }
 
-    std::string deviceName = GetDeviceName(m_device);
-    std::cout << "\t Selected Device Name : " << deviceName << std::endl;
+    m_kernel = variant->second.kernel;
+    m_kernelName = variant->second.name;
+    return CL_SUCCESS;
+}
 
-    //cl_context context = clCreateContext(g_contextProperties, devices.second.size(),
-    //	devices.second.data(), nullptr, nullptr, &error);	// create context will all device within the platform
-    m_context = clCreateContext(contextProperties, 1,
-        &m_device, nullptr, nullptr, &error);	// create context only with the selected device
-    checkCLError(error, "Create Context Failed");
-    std::cout << "Context created" << std::endl;
+std::string CLSimpleWrapper::makeBuildOptions(const std::map<std::string, std::string>& defines, const std::string& flags)
+{
+    std::string build_options;
+    for ( const auto& define : defines )
+    {
+        build_options += "-D " + define.first + (define.second.empty() ? "" : "=" + define.second) + " ";
+    }
+    return build_options + flags;
+}
 
-    m_cmdQueue = clCreateCommandQueue(m_context, m_device, 0, &error);
-    checkCLError(error, "Fail to create command queue");
+cl_int CLSimpleWrapper::createCLKernelFromFile(std::string kernel_file_path, std::string prog_name, std::string build_options)
+{
+    std::ifstream ifs(kernel_file_path);
 
-    std::cout << "Command Queue created" << std::endl;
+    std::string kernel_source_str = ifs ? std::string(std::istreambuf_iterator<char>(ifs), (std::istreambuf_iterator<char>())) : "";
 
-    return;
+    return createCLKernel(kernel_source_str, prog_name, build_options);
 }
 
-cl_int CLSimpleWrapper::createCLKernel(std::string& kernel_source_str, std::string prog_name)
+void CLSimpleWrapper::createKernels(cl_program program)
 {
     cl_int error = CL_SUCCESS;
+    cl_uint kernel_count = 0;
+    error = clCreateKernelsInProgram(program, 0, nullptr, &kernel_count);
+    checkCLError(error, "Create Kernel Failed");
 
-    const char* src = kernel_source_str.c_str();
-    m_program = clCreateProgramWithSource(m_context, 1,
-        &src, NULL, &error);
-    if ( error != CL_SUCCESS )
+    std::vector<cl_kernel> kernels(kernel_count);
+    error = clCreateKernelsInProgram(program, kernel_count, kernels.data(), nullptr);
+    checkCLError(error, "Create Kernel Failed");
+
+    for ( cl_kernel kernel : kernels )
     {
-        size_t len;
-        char buffer[2048];
-        clGetProgramBuildInfo(m_program, m_device,
-            CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, &len);
-        std::cout << "Build Error: " << buffer << std::endl;
-        clReleaseProgram(m_program);  // do we need to clear?
-        m_program = nullptr;
-        return error;
+        size_t size = 0;
+        clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, 0, nullptr, &size);
+        std::string kernel_name(size, '\0');
+        clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, size, const_cast<char*> (kernel_name.data()), nullptr);
+        kernel_name.resize(std::strlen(kernel_name.c_str()));    // drop the terminating null character
+
+        auto existing = m_kernels.find(kernel_name);
+        if ( existing != m_kernels.end() )
+        {
+            clReleaseKernel(existing->second);  // same name from a newer program replaces the old one
+        }
+        m_kernels[kernel_name] = kernel;
     }
+}
 
-    error = clBuildProgram(m_program, 1, &m_device, NULL, NULL, NULL);
-    checkCLError(error, "Program Build Failed");
+cl_int CLSimpleWrapper::selectKernel(std::string kernel_name)
+{
+    cl_int error = ensureKernels();
 
-    m_kernel = clCreateKernel(m_program, prog_name.c_str(), &error);
-    checkCLError(error, "Create Kernel Failed");
+    auto kernel = m_kernels.find(kernel_name);
+    if ( kernel == m_kernels.end() )
+    {
+        return (CL_SUCCESS != error) ? error : CL_INVALID_KERNEL_NAME;   // i.e. its async build failed
+    }
 
-    return error;
+    m_kernel = kernel->second;
+    m_kernelName = kernel_name;
+    return CL_SUCCESS;
 }
 
-cl_int CLSimpleWrapper::createCLKernelFromFile(std::string kernel_file_path, std::string prog_name)
+std::vector<std::string> CLSimpleWrapper::getKernelNames() const
 {
-    std::ifstream ifs(kernel_file_path);
+    std::vector<std::string> names;
+    for ( const auto& kernel : m_kernels )
+    {
+        names.push_back(kernel.first);
+    }
+    return names;
+}
 
-    std::string kernel_source_str = ifs ? std::string(std::istreambuf_iterator<char>(ifs), (std::istreambuf_iterator<char>())) : "";
+void CLSimpleWrapper::bindKernelBufferArg(unsigned int index, size_t buffer_index)
+{
+    setKernelArg(index, &m_args[buffer_index], sizeof(cl_mem));
+}
+
+void CLSimpleWrapper::setProgramCacheDir(std::string cache_dir)
+{
+    m_programCache.setCacheDir(cache_dir);
+}
 
-    return createCLKernel(kernel_source_str, prog_name);
+size_t CLSimpleWrapper::getProgramCacheHits() const
+{
+    return m_programCache.getHits();
+}
+
+size_t CLSimpleWrapper::getProgramCacheMisses() const
+{
+    return m_programCache.getMisses();
+}
+
+size_t CLSimpleWrapper::getBufferPoolHighWaterMark() const
+{
+    return m_bufferPool.getHighWaterMark();
+}
+
+double CLSimpleWrapper::getBufferPoolReuseRate() const
+{
+    return m_bufferPool.getReuseRate();
 }
 
-// note: we assume that args created in order
+// buffers are kept by kernel argument index and taken from the buffer pool.
 void CLSimpleWrapper::setKernelBufferArg(unsigned int index, void* buffer, size_t len)
 {
     cl_int error = CL_SUCCESS;
     cl_mem dev_buffer = nullptr;
-    if ( nullptr == buffer )
+
+    releaseKernelBufferArg(index);  // re-binding the argument, previous buffer can be reused
+
+    if ( BufferMode::HostMapped == m_bufferMode )
+    {
+        if ( nullptr == buffer )
+        {
+            dev_buffer = m_bufferPool.acquire(len, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR,   // for output
+                &error);
+            checkCLError(error, "Create Buffer Failed");
+        }
+        else if ( 0 == reinterpret_cast<uintptr_t>(buffer) % CL_HOST_BUFFER_ALIGNMENT )
+        {
+            // device works directly on the caller memory, it can be used for input and output.
+            //  not pooled: the buffer is tied to the host pointer.
+            dev_buffer = clCreateBuffer(m_context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR,
+                len, buffer, &error);
+            checkCLError(error, "Create Buffer Failed");
+        }
+        else
+        {
+            // unaligned host memory can't be used in place, copy it once into host visible memory.
+            dev_buffer = m_bufferPool.acquire(len, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, &error);
+            checkCLError(error, "Create Buffer Failed");
+
+            cl_event event = nullptr;
+            std::vector<cl_event> order = getOrderWaitList();
+            void* mapped_ptr = clEnqueueMapBuffer(m_cmdQueue, dev_buffer, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION,
+                0, len, (cl_uint)order.size(), order.empty() ? NULL : order.data(),
+                getProfilingEvent(&event), &error);
+            checkCLError(error, "Enqueue Map Buffer Failed");
+            recordProfilingEvent(event, "buffer " + std::to_string(index), "map");
+            std::memcpy(mapped_ptr, buffer, len);
+            order = getOrderWaitList();
+            error = clEnqueueUnmapMemObject(m_cmdQueue, dev_buffer, mapped_ptr,
+                (cl_uint)order.size(), order.empty() ? NULL : order.data(), getProfilingEvent(&event));
+            checkCLError(error, "Enqueue Unmap Buffer Failed");
+            recordProfilingEvent(event, "buffer " + std::to_string(index), "unmap");
+
+            if ( nullptr != m_recording )
+            {
+                m_recording->addWrite(index, buffer, len, 0);
+            }
+        }
+    }
+    else if ( nullptr == buffer )
     {
-        dev_buffer = clCreateBuffer(m_context, CL_MEM_WRITE_ONLY,   // for output
-            len, NULL, &error);
+        dev_buffer = m_bufferPool.acquire(len, CL_MEM_WRITE_ONLY,   // for output
+            &error);
         checkCLError(error, "Create Buffer Failed");
     }
     else
     {
-        dev_buffer = clCreateBuffer(m_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-            len, buffer, &error);
+        dev_buffer = m_bufferPool.acquire(len, CL_MEM_READ_ONLY, &error);
         checkCLError(error, "Create Buffer Failed");
-        
-        //dev_buffer = clCreateBuffer(m_context, CL_MEM_READ_ONLY,
-        //    len, nullptr, &error);
-        //checkCLError(error, "Create Buffer Failed");
-        //error = clEnqueueWriteBuffer(m_cmdQueue, dev_buffer, CL_TRUE, 0,
-        //    len, buffer, 0, NULL, NULL);
-        //checkCLError(error, "Enqueue Write Buffer Failed");
-    }
 
+        // pooled buffers can't use CL_MEM_COPY_HOST_PTR, blocking write keeps the same semantic:
+        //  caller is free to reuse the host buffer once we return.
+        cl_event event = nullptr;
+        std::vector<cl_event> order = getOrderWaitList();
+        error = clEnqueueWriteBuffer(m_cmdQueue, dev_buffer, CL_TRUE, 0,
+            len, buffer, (cl_uint)order.size(), order.empty() ? NULL : order.data(), getProfilingEvent(&event));
+        checkCLError(error, "Enqueue Write Buffer Failed");
+        recordProfilingEvent(event, "buffer " + std::to_string(index), "write");
 
+        if ( nullptr != m_recording )
+        {
+            m_recording->addWrite(index, buffer, len, 0);
+        }
+    }
 
-    m_args.push_back(dev_buffer);   // keep the buffers to be cleared later
+    if ( m_args.size() <= index )
+    {
+        m_args.resize(index + 1, nullptr);
+    }
+    m_args[index] = dev_buffer;   // keep the buffers to be cleared later
 
     setKernelArg(index, &dev_buffer, sizeof(cl_mem));
 }
 
-// generic implementation for setting OpenCL primitive type argument.
-void CLSimpleWrapper::setKernelArg(unsigned int index, const void* buffer, const size_t len)
+// releases the file view used in place by a CL_MEM_USE_HOST_PTR buffer, once the buffer is destroyed by the runtime.
+static void CL_CALLBACK releaseMappedFile(cl_mem /*buffer*/, void* user_data)
 {
-    cl_int error = CL_SUCCESS;
-    error = clSetKernelArg(m_kernel, index,
-        len, // size of the argument type in buffer.
-        buffer);
-    checkCLError(error, "Set Kernel Arg Failed");
+    delete static_cast<CLMappedFile*>(user_data);
 }
 
-// note: we assume that args created in order, caller is responsible to allocate the memory for outData.
-void CLSimpleWrapper::readBuffer(void* outData, size_t index, size_t len)
+cl_int CLSimpleWrapper::setKernelBufferArgFromFile(unsigned int index, std::string file_path, size_t offset, size_t len)
 {
     cl_int error = CL_SUCCESS;
+    cl_mem dev_buffer = nullptr;
 
-    //outData = (int*)malloc(len); We are using blocking read here
-    error = clEnqueueReadBuffer(m_cmdQueue, m_args[index], CL_TRUE, 0,
-        len, outData, 0, NULL, NULL);
-    checkCLError(error, "Enqueue Read Buffer Failed");
+    std::unique_ptr<CLMappedFile> file(new CLMappedFile());
+    if ( !file->open(file_path) )
+    {
+        return CL_INVALID_VALUE;
+    }
+    if ( 0 == len && offset < file->getSize() )
+    {
+        len = file->getSize() - offset;
+    }
+    if ( 0 == len || offset + len > file->getSize() )
+    {
+        return CL_INVALID_VALUE;
+    }
+
+    releaseKernelBufferArg(index);
+
+    if ( BufferMode::HostMapped == m_bufferMode )
+    {
+        const void* data = file->map(offset, len);
+        if ( nullptr != data && 0 == reinterpret_cast<uintptr_t>(data) % CL_HOST_BUFFER_ALIGNMENT )
+        {
+            // device reads the file pages in place, the view is kept as long as the buffer
+            dev_buffer = clCreateBuffer(m_context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
+                len, const_cast<void*>(data), &error);
+            if ( CL_SUCCESS != error )
+            {
+                dev_buffer = nullptr;   // i.e. pages can't be pinned, uploaded below
+            }
+            else if ( CL_SUCCESS == clSetMemObjectDestructorCallback(dev_buffer, releaseMappedFile, file.get()) )
+            {
+                file.release();
+            }
+            else
+            {
+                clReleaseMemObject(dev_buffer);
+                dev_buffer = nullptr;
+            }
+        }
+    }
+
+    if ( nullptr == dev_buffer )
+    {
+        dev_buffer = m_bufferPool.acquire(len, CL_MEM_READ_ONLY, &error);
+        checkCLError(error, "Create Buffer Failed");
+
+        // two views in turn: the OS reads the next chunk ahead while the current one is uploaded,
+        //  and a chunk is unmapped as soon as it is on the device.
+        CLMappedFile ahead;
+        ahead.open(file_path);
+        CLMappedFile* views[2] = { file.get(), &ahead };
+        const void* chunk = views[0]->map(offset, std::min<size_t>(CL_FILE_CHUNK_SIZE, len));
+        for ( size_t done = 0, i = 0; done < len; i++ )
+        {
+            size_t chunk_len = std::min<size_t>(CL_FILE_CHUNK_SIZE, len - done);
+            const void* next = nullptr;
+            if ( done + chunk_len < len )
+            {
+                CLMappedFile* next_view = views[(i + 1) % 2];
+                next = next_view->map(offset + done + chunk_len, std::min<size_t>(CL_FILE_CHUNK_SIZE, len - done - chunk_len));
+                next_view->prefetch();
+            }
+
+            if ( nullptr == chunk )
+            {
+                if ( !m_bufferPool.release(dev_buffer) )
+                {
+                    clReleaseMemObject(dev_buffer);
+                }
+                return CL_INVALID_VALUE;
+            }
+
+            cl_event event = nullptr;
+            std::vector<cl_event> order = getOrderWaitList();
+            error = clEnqueueWriteBuffer(m_cmdQueue, dev_buffer, CL_TRUE, done, chunk_len, chunk,
+                (cl_uint)order.size(), order.empty() ? NULL : order.data(), getProfilingEvent(&event));
+            checkCLError(error, "Enqueue Write Buffer Failed");
+            recordProfilingEvent(event, "file " + std::to_string(index), "write");
+
+            views[i % 2]->unmap();
+            chunk = next;
+            done += chunk_len;
+        }
+    }
+
+    if ( m_args.size() <= index )
+    {
+        m_args.resize(index + 1, nullptr);
+    }
+    m_args[index] = dev_buffer;
+
+    setKernelArg(index, &dev_buffer, sizeof(cl_mem));
+    return CL_SUCCESS;
 }
 
-// let caller to have control the global item size and local item size
-void CLSimpleWrapper::executeKernel(size_t workSize,     // size of work item: i.e. size of globalItemSize[] array.
-    size_t* globalItemSize,
-    size_t* localItemSize)// no idea how it works, just set to NULL for now.
+void CLSimpleWrapper::setKernelResidentBufferArg(unsigned int index, const void* buffer, size_t len, const std::string& tag)
 {
     cl_int error = CL_SUCCESS;
-    error = clEnqueueNDRangeKernel(m_cmdQueue, m_kernel, (cl_uint)workSize,
-        NULL,   // offset always start from beginning
-        globalItemSize, localItemSize, 0, NULL, NULL);
-    checkCLError(error, "Enqueue NDRange Kernel Failed");
+
+    if ( nullptr == m_session || !m_session->isValid() )
+    {
+        setKernelBufferArg(index, const_cast<void*>(buffer), len);   // no residency cache, uploaded every time
+        return;
+    }
+
+    releaseKernelBufferArg(index);
+
+    // tags and hashes can't collide: a hash key starts with the length
+    CLResidencyCache& cache = m_session->getResidencyCache();
+    std::string key = tag.empty() ? CLResidencyCache::hashContent(buffer, len) : "tag:" + tag;
+    cl_mem dev_buffer = cache.find(key, len);
+    if ( nullptr == dev_buffer )
+    {
+        // not pooled: the buffer is shared with the cache, released by the last of them
+        dev_buffer = clCreateBuffer(m_context, CL_MEM_READ_ONLY, len, NULL, &error);
+        checkCLError(error, "Create Buffer Failed");
+
+        cl_event event = nullptr;
+        std::vector<cl_event> order = getOrderWaitList();
+        error = clEnqueueWriteBuffer(m_cmdQueue, dev_buffer, CL_TRUE, 0,
+            len, buffer, (cl_uint)order.size(), order.empty() ? NULL : order.data(), getProfilingEvent(&event));
+        checkCLError(error, "Enqueue Write Buffer Failed");
+        recordProfilingEvent(event, "resident " + std::to_string(index), "write");
+
+        cache.insert(key, dev_buffer, len);
+    }
+
+    if ( m_args.size() <= index )
+    {
+        m_args.resize(index + 1, nullptr);
+    }
+    m_args[index] = dev_buffer;
+
+    setKernelArg(index, &dev_buffer, sizeof(cl_mem));
 }
 
-std::string CLSimpleWrapper::GetPlatformName(cl_platform_id id)
+void CLSimpleWrapper::setKernelScratchBufferArg(unsigned int index, size_t len)
 {
-    size_t size = 0;
-    clGetPlatformInfo(id, CL_PLATFORM_NAME, 0, nullptr, &size);
+    createScratchBuffer(index, len);
 
-    std::string result;
-    result.resize(size);
-    clGetPlatformInfo(id, CL_PLATFORM_NAME, size,
-        const_cast<char*> (result.data()), nullptr);
+    setKernelArg(index, &m_args[index], sizeof(cl_mem));
+}
 
-    return result;
+void CLSimpleWrapper::createScratchBuffer(size_t buffer_index, size_t len)
+{
+    cl_int error = CL_SUCCESS;
+
+    releaseKernelBufferArg((unsigned int)buffer_index);
+
+    cl_mem dev_buffer = m_bufferPool.acquire(len, CL_MEM_READ_WRITE, &error);
+    checkCLError(error, "Create Buffer Failed");
+
+    if ( m_args.size() <= buffer_index )
+    {
+        m_args.resize(buffer_index + 1, nullptr);
+    }
+    m_args[buffer_index] = dev_buffer;
 }
 
-std::string CLSimpleWrapper::GetDeviceName(cl_device_id id)
+void CLSimpleWrapper::releaseKernelBufferArg(unsigned int index)
 {
-    size_t size = 0;
-    clGetDeviceInfo(id, CL_DEVICE_NAME, 0, nullptr, &size);
+    if ( index >= m_args.size() || nullptr == m_args[index] )
+    {
+        return;
+    }
 
-    std::string result;
-    result.resize(size);
-    clGetDeviceInfo(id, CL_DEVICE_NAME, size,
-        const_cast<char*> (result.data()), nullptr);
+    if ( !m_bufferPool.release(m_args[index]) )
+    {
+        invalidateKernelArg(m_args[index]);
+        clReleaseMemObject(m_args[index]);
+    }
+    m_args[index] = nullptr;
+}
 
-    return result;
+void CLSimpleWrapper::invalidateKernelArg(cl_mem buffer)
+{
+    for ( auto& values : m_argValues )
+    {
+        for ( std::vector<char>& value : values.second )
+        {
+            if ( value.size() == sizeof(cl_mem) && 0 == std::memcmp(value.data(), &buffer, sizeof(cl_mem)) )
+            {
+                value.clear();
+            }
+        }
+    }
 }
 
-void CLSimpleWrapper::clear()
+void CLSimpleWrapper::setBufferMode(BufferMode mode)
 {
-    cl_int error = CL_SUCCESS;
-    error = clFlush(m_cmdQueue);
-    error = clFinish(m_cmdQueue);
-    error = clReleaseKernel(m_kernel);
-    error = clReleaseProgram(m_program);
+    m_bufferMode = mode;
+}
+
+void* CLSimpleWrapper::mapBuffer(size_t index, size_t len, cl_map_flags flags)
+{
+    cl_int error = CL_SUCCESS;
+    cl_event event = nullptr;
+    std::vector<cl_event> order = getOrderWaitList();
+
+    void* mapped_ptr = clEnqueueMapBuffer(m_cmdQueue, m_args[index], CL_TRUE, flags,
+        0, len, (cl_uint)order.size(), order.empty() ? NULL : order.data(), getProfilingEvent(&event), &error);
+    checkCLError(error, "Enqueue Map Buffer Failed");
+    recordProfilingEvent(event, "buffer " + std::to_string(index), "map");
+
+    return mapped_ptr;
+}
+
+void CLSimpleWrapper::unmapBuffer(size_t index, void* mapped_ptr)
+{
+    cl_int error = CL_SUCCESS;
+    cl_event event = nullptr;
+    std::vector<cl_event> order = getOrderWaitList();
+
+    error = clEnqueueUnmapMemObject(m_cmdQueue, m_args[index], mapped_ptr,
+        (cl_uint)order.size(), order.empty() ? NULL : order.data(), getProfilingEvent(&event));
+    checkCLError(error, "Enqueue Unmap Buffer Failed");
+    recordProfilingEvent(event, "buffer " + std::to_string(index), "unmap");
+}
+
+void* CLSimpleWrapper::allocHostBuffer(size_t len)
+{
+    // round up to whole pages, some drivers also require the size to be a multiple of the cache line for zero-copy.
+    len = (len + CL_HOST_BUFFER_ALIGNMENT - 1) / CL_HOST_BUFFER_ALIGNMENT * CL_HOST_BUFFER_ALIGNMENT;
+#ifdef _WIN32
+    return _aligned_malloc(len, CL_HOST_BUFFER_ALIGNMENT);
+#else
+    void* buffer = nullptr;
+    if ( 0 != posix_memalign(&buffer, CL_HOST_BUFFER_ALIGNMENT, len) )
+    {
+        return nullptr;
+    }
+    return buffer;
+#endif
+}
+
+void CLSimpleWrapper::freeHostBuffer(void* buffer)
+{
+#ifdef _WIN32
+    _aligned_free(buffer);
+#else
+    free(buffer);
+#endif
+}
+
+// generic implementation for setting OpenCL primitive type argument.
+void CLSimpleWrapper::setKernelArg(unsigned int index, const void* buffer, const size_t len)
+{
+    ensureKernels();
+
+    cl_int error = CL_SUCCESS;
+
+    // unchanged value (i.e. matrix size, or the same pooled buffer) is already set on the kernel.
+    //  NULL buffer is a __local size, not cached.
+    std::vector<std::vector<char> >& values = m_argValues[m_kernel];
+    if ( values.size() <= index )
+    {
+        values.resize(index + 1);
+    }
+    const char* value = static_cast<const char*>(buffer);
+    if ( nullptr != buffer && values[index].size() == len && std::equal(value, value + len, values[index].begin()) )
+    {
+        return;
+    }
+
+    error = clSetKernelArg(m_kernel, index,
+        len, // size of the argument type in buffer.
+        buffer);
+    checkCLError(error, "Set Kernel Arg Failed");
+
+    if ( nullptr != buffer )
+    {
+        values[index].assign(value, value + len);
+    }
+    else
+    {
+        values[index].clear();
+    }
+}
+
+void CLSimpleWrapper::writeBuffer(size_t index, const void* data, size_t len, size_t offset)
+{
+    cl_int error = CL_SUCCESS;
+    cl_event event = nullptr;
+    std::vector<cl_event> order = getOrderWaitList();
+
+    error = clEnqueueWriteBuffer(m_cmdQueue, m_args[index], CL_TRUE, offset,
+        len, data, (cl_uint)order.size(), order.empty() ? NULL : order.data(), getProfilingEvent(&event));
+    checkCLError(error, "Enqueue Write Buffer Failed");
+    recordProfilingEvent(event, "buffer " + std::to_string(index), "write");
+
+    if ( nullptr != m_recording )
+    {
+        m_recording->addWrite(index, data, len, offset);
+    }
+}
+
+void CLSimpleWrapper::writeBufferRect(size_t index, const void* data, const size_t* buffer_origin, const size_t* host_origin,
+    const size_t* region, size_t buffer_row_pitch, size_t host_row_pitch)
+{
+    cl_int error = CL_SUCCESS;
+    cl_event event = nullptr;
+    std::vector<cl_event> order = getOrderWaitList();
+
+    // slice pitches of 0 are computed from the row pitches and region[1]
+    error = clEnqueueWriteBufferRect(m_cmdQueue, m_args[index], CL_TRUE, buffer_origin, host_origin, region,
+        buffer_row_pitch, 0, host_row_pitch, 0, data,
+        (cl_uint)order.size(), order.empty() ? NULL : order.data(), getProfilingEvent(&event));
+    checkCLError(error, "Enqueue Write Buffer Rect Failed");
+    recordProfilingEvent(event, "buffer " + std::to_string(index), "write");
+
+    if ( nullptr != m_recording )
+    {
+        m_recording->addWriteRect(index, data, buffer_origin, host_origin, region, buffer_row_pitch, host_row_pitch);
+    }
+}
+
+// note: index is the kernel argument index of the buffer, caller is responsible to allocate the memory for outData.
+void CLSimpleWrapper::readBuffer(void* outData, size_t index, size_t len, size_t offset)
+{
+    cl_int error = CL_SUCCESS;
+    cl_event event = nullptr;
+    std::vector<cl_event> order = getOrderWaitList();
+
+    //outData = (int*)malloc(len); We are using blocking read here
+    error = clEnqueueReadBuffer(m_cmdQueue, m_args[index], CL_TRUE, offset,
+        len, outData, (cl_uint)order.size(), order.empty() ? NULL : order.data(), getProfilingEvent(&event));
+    checkCLError(error, "Enqueue Read Buffer Failed");
+    recordProfilingEvent(event, "buffer " + std::to_string(index), "read");
+
+    if ( nullptr != m_recording )
+    {
+        m_recording->addRead(index, outData, len, offset);
+    }
+}
+
+// let caller to have control the global item size and local item size
+void CLSimpleWrapper::executeKernel(size_t workSize,     // size of work item: i.e. size of globalItemSize[] array.
+    size_t* globalItemSize,
+    size_t* localItemSize)// NULL: driver default, or the tuned local size when autotune is enabled.
+{
+    ensureKernels();
+
+    cl_int error = CL_SUCCESS;
+    cl_event event = nullptr;
+    std::vector<size_t> tuned;
+    localItemSize = getLaunchLocalSize(workSize, globalItemSize, localItemSize, tuned);
+    std::vector<cl_event> order = getOrderWaitList();
+
+    error = clEnqueueNDRangeKernel(m_cmdQueue, m_kernel, (cl_uint)workSize,
+        NULL,   // offset always start from beginning
+        globalItemSize, localItemSize,
+        (cl_uint)order.size(), order.empty() ? NULL : order.data(), getProfilingEvent(&event));
+    checkCLError(error, "Enqueue NDRange Kernel Failed");
+    recordProfilingEvent(event, m_kernelName, "kernel");
+
+    if ( nullptr != m_recording )
+    {
+        m_recording->addKernel(m_kernel, m_kernelName, getRecordedArgs(), workSize, globalItemSize, localItemSize);
+    }
+}
+
+void CLSimpleWrapper::setKernelSplitBufferArg(unsigned int index, size_t len)
+{
+    cl_int error = CL_SUCCESS;
+
+    std::vector<cl_mem>& buffers = m_splitArgs[index];
+    for ( cl_mem buffer : buffers )
+    {
+        m_bufferPool.release(buffer);
+    }
+    buffers.clear();
+
+    for ( size_t i = 0; i < m_devices.size(); i++ )
+    {
+        buffers.push_back(m_bufferPool.acquire(len, CL_MEM_WRITE_ONLY, &error));
+        checkCLError(error, "Create Buffer Failed");
+    }
+}
+
+void CLSimpleWrapper::executeKernelSplit(size_t workSize,
+    size_t* globalItemSize,
+    size_t* localItemSize,
+    size_t split_dim)
+{
+    ensureKernels();
+
+    cl_int error = CL_SUCCESS;
+
+    updateSplitRatios();    // from the previous run, if it was not read back yet
+
+    size_t granularity = (nullptr == localItemSize) ? 1 : localItemSize[split_dim];
+    m_splitRanges = getSplitRanges(m_splitRatios, globalItemSize[split_dim], granularity);
+
+    for ( size_t i = 0; i < m_devices.size(); i++ )
+    {
+        if ( 0 == m_splitRanges[i].second )
+        {
+            m_splitEvents.push_back(CLEvent());
+            continue;
+        }
+
+        size_t offset[3] = { 0, 0, 0 };
+        size_t global[3] = { 0, 0, 0 };
+        for ( size_t dim = 0; dim < workSize; dim++ )
+        {
+            global[dim] = globalItemSize[dim];
+        }
+        offset[split_dim] = m_splitRanges[i].first;
+        global[split_dim] = m_splitRanges[i].second;
+
+        // kernel arguments are captured at enqueue time, so each device gets its own output copy.
+        for ( auto& split_arg : m_splitArgs )
+        {
+            setKernelArg(split_arg.first, &split_arg.second[i], sizeof(cl_mem));
+        }
+
+        cl_event event = nullptr;
+        error = clEnqueueNDRangeKernel(m_cmdQueues[i], m_kernel, (cl_uint)workSize,
+            offset, global, localItemSize, 0, NULL, &event);
+        checkCLError(error, "Enqueue NDRange Kernel Failed");
+        m_profiler.recordEvent(event, m_kernelName + " @device " + std::to_string(i), "kernel");
+        m_splitEvents.push_back(CLEvent(event));
+
+        clFlush(m_cmdQueues[i]);    // start this device before enqueuing the next one
+    }
+}
+
+void CLSimpleWrapper::readBufferSplit(void* outData, size_t index, size_t slice_len)
+{
+    cl_int error = CL_SUCCESS;
+    std::vector<CLEvent> read_events;
+    std::vector<cl_mem>& buffers = m_splitArgs[(unsigned int)index];
+
+    for ( size_t i = 0; i < m_devices.size(); i++ )
+    {
+        if ( 0 == m_splitRanges[i].second )
+        {
+            continue;
+        }
+
+        // explicit dependency, the session queues may be out-of-order
+        cl_event kernel_event = (i < m_splitEvents.size()) ? m_splitEvents[i].get() : nullptr;
+        size_t offset = m_splitRanges[i].first * slice_len;
+        size_t len = m_splitRanges[i].second * slice_len;
+        cl_event event = nullptr;
+        error = clEnqueueReadBuffer(m_cmdQueues[i], buffers[i], CL_FALSE, offset,
+            len, static_cast<char*>(outData) + offset,
+            kernel_event ? 1 : 0, kernel_event ? &kernel_event : NULL, &event);
+        checkCLError(error, "Enqueue Read Buffer Failed");
+        m_profiler.recordEvent(event, "buffer " + std::to_string(index) + " @device " + std::to_string(i), "read");
+        read_events.push_back(CLEvent(event));
+    }
+
+    CLEvent::waitAll(read_events);
+    updateSplitRatios();
+}
+
+void CLSimpleWrapper::setSplitPolicy(SplitPolicy policy)
+{
+    m_splitPolicy = policy;
+}
+
+void CLSimpleWrapper::setSplitRatios(const std::vector<double>& ratios)
+{
+    double total = 0.0;
+    for ( double ratio : ratios )
+    {
+        total += ratio;
+    }
+
+    m_splitRatios.assign(m_devices.size(), 0.0);
+    for ( size_t i = 0; i < m_splitRatios.size() && i < ratios.size(); i++ )
+    {
+        m_splitRatios[i] = ratios[i] / total;
+    }
+}
+
+std::vector<double> CLSimpleWrapper::getSplitRatios() const
+{
+    return m_splitRatios;
+}
+
+std::vector<std::pair<size_t, size_t> > CLSimpleWrapper::getSplitRanges(const std::vector<double>& ratios,
+    size_t total, size_t granularity)
+{
+    std::vector<std::pair<size_t, size_t> > ranges;
+    size_t units = total / granularity;
+    size_t start = 0;
+
+    for ( size_t i = 0; i < ratios.size(); i++ )
+    {
+        // last device takes the remainder, so that rounding never drops a unit
+        size_t count = (i + 1 == ratios.size()) ?
+            units - start :
+            std::min(units - start, (size_t)(ratios[i] * units + 0.5));
+        ranges.push_back(std::make_pair(start * granularity, count * granularity));
+        start += count;
+    }
+
+    return ranges;
+}
+
+void CLSimpleWrapper::updateSplitRatios()
+{
+    if ( m_splitEvents.empty() )
+    {
+        return;
+    }
+
+    if ( SplitPolicy::Throughput == m_splitPolicy )
+    {
+        CLEvent::waitAll(m_splitEvents);
+
+        std::vector<double> throughputs(m_devices.size(), 0.0);
+        bool is_measured = true;
+        for ( size_t i = 0; i < m_devices.size(); i++ )
+        {
+            cl_ulong start = 0, end = 0;
+            cl_event event = m_splitEvents[i].get();
+            if ( nullptr == event )
+            {
+                is_measured = false;    // device got no work, can't measure it: keep the current ratios
+                break;
+            }
+            clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, nullptr);
+            clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, nullptr);
+            throughputs[i] = m_splitRanges[i].second / double(std::max<cl_ulong>(end - start, 1));
+        }
+
+        if ( is_measured )
+        {
+            // blend with the current ratios, a single noisy run should not swing the split.
+            double total = 0.0;
+            for ( double throughput : throughputs )
+            {
+                total += throughput;
+            }
+            for ( size_t i = 0; i < m_splitRatios.size(); i++ )
+            {
+                m_splitRatios[i] = 0.5 * m_splitRatios[i] + 0.5 * throughputs[i] / total;
+            }
+        }
+    }
+
+    m_splitEvents.clear();
+}
+
+CLEvent CLSimpleWrapper::executeKernelAsync(size_t workSize,
+    size_t* globalItemSize,
+    size_t* localItemSize,
+    const std::vector<CLEvent>& wait_list)
+{
+    ensureKernels();
+
+    cl_int error = CL_SUCCESS;
+    cl_event event = nullptr;
+    std::vector<cl_event> events = CLEvent::toWaitList(wait_list);
+    std::vector<size_t> tuned;
+    localItemSize = getLaunchLocalSize(workSize, globalItemSize, localItemSize, tuned);
+
+    error = clEnqueueNDRangeKernel(m_cmdQueue, m_kernel, (cl_uint)workSize,
+        NULL,   // offset always start from beginning
+        globalItemSize, localItemSize,
+        (cl_uint)events.size(), events.empty() ? NULL : events.data(), &event);
+    checkCLError(error, "Enqueue NDRange Kernel Failed");
+    m_profiler.recordEvent(event, m_kernelName, "kernel");
+
+    clFlush(m_cmdQueue);    // make sure the device starts while the host keeps working
+    return CLEvent(event);
+}
+
+CLEvent CLSimpleWrapper::readBufferAsync(void* outData, size_t index, size_t len,
+    const std::vector<CLEvent>& wait_list)
+{
+    cl_int error = CL_SUCCESS;
+    cl_event event = nullptr;
+    std::vector<cl_event> events = CLEvent::toWaitList(wait_list);
+
+    error = clEnqueueReadBuffer(m_cmdQueue, m_args[index], CL_FALSE, 0,
+        len, outData, (cl_uint)events.size(), events.empty() ? NULL : events.data(), &event);
+    checkCLError(error, "Enqueue Read Buffer Failed");
+    m_profiler.recordEvent(event, "buffer " + std::to_string(index), "read");
+
+    clFlush(m_cmdQueue);
+    return CLEvent(event);
+}
+
+CLEvent CLSimpleWrapper::writeBufferAsync(size_t index, const void* data, size_t len,
+    const std::vector<CLEvent>& wait_list)
+{
+    cl_int error = CL_SUCCESS;
+    cl_event event = nullptr;
+    std::vector<cl_event> events = CLEvent::toWaitList(wait_list);
+
+    error = clEnqueueWriteBuffer(m_cmdQueue, m_args[index], CL_FALSE, 0,
+        len, data, (cl_uint)events.size(), events.empty() ? NULL : events.data(), &event);
+    checkCLError(error, "Enqueue Write Buffer Failed");
+    m_profiler.recordEvent(event, "buffer " + std::to_string(index), "write");
+
+    clFlush(m_cmdQueue);
+    return CLEvent(event);
+}
+
+CLEvent CLSimpleWrapper::whenAll(const std::vector<CLEvent>& events)
+{
+    cl_int error = CL_SUCCESS;
+    cl_event event = nullptr;
+    std::vector<cl_event> wait_list = CLEvent::toWaitList(events);
+
+    // marker with an empty wait list waits for every previously enqueued command, which is also correct here.
+    error = clEnqueueMarkerWithWaitList(m_cmdQueue,
+        (cl_uint)wait_list.size(), wait_list.empty() ? NULL : wait_list.data(), &event);
+    checkCLError(error, "Enqueue Marker Failed");
+
+    return CLEvent(event);
+}
+
+void CLSimpleWrapper::wait(const std::vector<CLEvent>& events)
+{
+    CLEvent::waitAll(events);
+}
+
+void CLSimpleWrapper::finish()
+{
+    cl_int error = clFinish(m_cmdQueue);
+    checkCLError(error, "Finish Command Queue Failed");
+}
+
+void CLSimpleWrapper::executeBatch(const std::vector<CLBatchJob>& jobs)
+{
+    ensureKernels();
+
+    cl_int error = CL_SUCCESS;
+    if ( jobs.empty() )
+    {
+        return;
+    }
+
+    // sub-buffer origins must be aligned to CL_DEVICE_MEM_BASE_ADDR_ALIGN (in bits)
+    cl_uint align_bits = 0;
+    clGetDeviceInfo(m_device, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(cl_uint), &align_bits, nullptr);
+    size_t alignment = std::max<size_t>(1, align_bits / 8);
+
+    // offset of every buffer of every job within the packed input or output
+    size_t input_len = 0;
+    size_t output_len = 0;
+    std::vector<std::vector<size_t> > offsets(jobs.size());
+    for ( size_t j = 0; j < jobs.size(); j++ )
+    {
+        for ( const CLBatchJob::Buffer& buffer : jobs[j].getBuffers() )
+        {
+            size_t& total = (nullptr != buffer.input) ? input_len : output_len;
+            offsets[j].push_back(total);
+            total += (buffer.len + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    std::vector<char> packed_input(input_len);
+    std::vector<char> packed_output(output_len);
+    for ( size_t j = 0; j < jobs.size(); j++ )
+    {
+        const std::vector<CLBatchJob::Buffer>& buffers = jobs[j].getBuffers();
+        for ( size_t i = 0; i < buffers.size(); i++ )
+        {
+            if ( nullptr != buffers[i].input )
+            {
+                std::memcpy(packed_input.data() + offsets[j][i], buffers[i].input, buffers[i].len);
+            }
+        }
+    }
+
+    cl_mem input_buffer = nullptr;
+    cl_mem output_buffer = nullptr;
+    cl_event upload_event = nullptr;
+    if ( input_len > 0 )
+    {
+        input_buffer = m_bufferPool.acquire(input_len, CL_MEM_READ_ONLY, &error);
+        checkCLError(error, "Create Buffer Failed");
+
+        std::vector<cl_event> order = getOrderWaitList();
+        error = clEnqueueWriteBuffer(m_cmdQueue, input_buffer, CL_FALSE, 0, input_len, packed_input.data(),
+            (cl_uint)order.size(), order.empty() ? NULL : order.data(), &upload_event);
+        checkCLError(error, "Enqueue Write Buffer Failed");
+        m_profiler.recordEvent(upload_event, "batch", "write");
+    }
+    if ( output_len > 0 )
+    {
+        output_buffer = m_bufferPool.acquire(output_len, CL_MEM_WRITE_ONLY, &error);
+        checkCLError(error, "Create Buffer Failed");
+    }
+
+    // every launch only waits for the upload, no host synchronization in between
+    std::string current_kernel = m_kernelName;
+    std::vector<cl_mem> sub_buffers;
+    std::vector<CLEvent> kernel_events;
+    for ( size_t j = 0; j < jobs.size(); j++ )
+    {
+        const CLBatchJob& job = jobs[j];
+        if ( !job.getKernelName().empty() )
+        {
+            error = selectKernel(job.getKernelName());
+            checkCLError(error, "Select Kernel Failed");
+        }
+
+        for ( const CLBatchJob::Arg& arg : job.getArgs() )
+        {
+            setKernelArg(arg.index, arg.value.data(), arg.value.size());
+        }
+
+        const std::vector<CLBatchJob::Buffer>& buffers = job.getBuffers();
+        for ( size_t i = 0; i < buffers.size(); i++ )
+        {
+            bool is_input = (nullptr != buffers[i].input);
+            cl_buffer_region region = { offsets[j][i], buffers[i].len };
+            cl_mem sub_buffer = clCreateSubBuffer(is_input ? input_buffer : output_buffer,
+                is_input ? CL_MEM_READ_ONLY : CL_MEM_WRITE_ONLY, CL_BUFFER_CREATE_TYPE_REGION, &region, &error);
+            checkCLError(error, "Create Sub Buffer Failed");
+            sub_buffers.push_back(sub_buffer);
+            setKernelArg(buffers[i].index, &sub_buffer, sizeof(cl_mem));
+        }
+
+        cl_event event = nullptr;
+        error = clEnqueueNDRangeKernel(m_cmdQueue, m_kernel, (cl_uint)job.getWorkSize(),
+            NULL, job.getGlobalItemSize(), job.getLocalItemSize(),
+            upload_event ? 1 : 0, upload_event ? &upload_event : NULL, getProfilingEvent(&event));
+        checkCLError(error, "Enqueue NDRange Kernel Failed");
+        if ( nullptr != event )
+        {
+            m_profiler.recordEvent(event, m_kernelName, "kernel");
+            kernel_events.push_back(CLEvent(event));   // download dependencies on an out-of-order queue
+        }
+    }
+    clFlush(m_cmdQueue);
+
+    // the single synchronization of the batch
+    if ( nullptr != output_buffer )
+    {
+        std::vector<cl_event> wait_list = CLEvent::toWaitList(kernel_events);
+        cl_event event = nullptr;
+        error = clEnqueueReadBuffer(m_cmdQueue, output_buffer, CL_TRUE, 0, output_len, packed_output.data(),
+            (cl_uint)wait_list.size(), wait_list.empty() ? NULL : wait_list.data(), getProfilingEvent(&event));
+        checkCLError(error, "Enqueue Read Buffer Failed");
+        recordProfilingEvent(event, "batch", "read");
+    }
+    else
+    {
+        error = clFinish(m_cmdQueue);
+        checkCLError(error, "Finish Command Queue Failed");
+    }
+
+    for ( size_t j = 0; j < jobs.size(); j++ )
+    {
+        const std::vector<CLBatchJob::Buffer>& buffers = jobs[j].getBuffers();
+        for ( size_t i = 0; i < buffers.size(); i++ )
+        {
+            if ( nullptr != buffers[i].output )
+            {
+                std::memcpy(buffers[i].output, packed_output.data() + offsets[j][i], buffers[i].len);
+            }
+        }
+    }
+
+    for ( cl_mem sub_buffer : sub_buffers )
+    {
+        invalidateKernelArg(sub_buffer);
+        clReleaseMemObject(sub_buffer);
+    }
+    if ( nullptr != upload_event )
+    {
+        clReleaseEvent(upload_event);
+    }
+    if ( nullptr != input_buffer )
+    {
+        m_bufferPool.release(input_buffer);
+    }
+    if ( nullptr != output_buffer )
+    {
+        m_bufferPool.release(output_buffer);
+    }
+    selectKernel(current_kernel);
+}
+
+void CLSimpleWrapper::beginRecording(CLCommandGraph& graph)
+{
+    graph.clear();
+    m_recording = &graph;
+}
+
+void CLSimpleWrapper::endRecording()
+{
+    m_recording = nullptr;
+}
+
+void CLSimpleWrapper::replay(const CLCommandGraph& graph)
+{
+    cl_int error = CL_SUCCESS;
+    cl_kernel current_kernel = m_kernel;
+    std::string current_kernel_name = m_kernelName;
+    CLEvent previous = m_lastEvent;
+
+    // on an out-of-order queue, each node waits for the nodes it depends on only,
+    //  nodes without dependency wait for the commands enqueued before the replay.
+    const std::vector<CLCommandGraph::Node>& nodes = graph.getNodes();
+    std::vector<CLEvent> events(nodes.size());
+    for ( size_t i = 0; i < nodes.size(); i++ )
+    {
+        const CLCommandGraph::Node& node = nodes[i];
+        std::vector<cl_event> wait_list;
+        if ( m_isOutOfOrder )
+        {
+            for ( size_t dependency : node.dependencies )
+            {
+                wait_list.push_back(events[dependency].get());
+            }
+            if ( node.dependencies.empty() && previous.isValid() )
+            {
+                wait_list.push_back(previous.get());
+            }
+        }
+
+        cl_event event = nullptr;
+        switch ( node.type )
+        {
+        case CLCommandGraph::NodeType::Write:
+            error = clEnqueueWriteBuffer(m_cmdQueue, m_args[node.buffer_index], CL_FALSE, node.offset, node.len,
+                node.host_ptr, (cl_uint)wait_list.size(), wait_list.empty() ? NULL : wait_list.data(), getProfilingEvent(&event));
+            checkCLError(error, "Enqueue Write Buffer Failed");
+            break;
+
+        case CLCommandGraph::NodeType::WriteRect:
+            error = clEnqueueWriteBufferRect(m_cmdQueue, m_args[node.buffer_index], CL_FALSE, node.buffer_origin,
+                node.host_origin, node.region, node.buffer_row_pitch, 0, node.host_row_pitch, 0, node.host_ptr,
+                (cl_uint)wait_list.size(), wait_list.empty() ? NULL : wait_list.data(), getProfilingEvent(&event));
+            checkCLError(error, "Enqueue Write Buffer Rect Failed");
+            break;
+
+        case CLCommandGraph::NodeType::Kernel:
+            m_kernel = node.kernel;
+            m_kernelName = node.kernel_name;
+            for ( const CLCommandGraph::KernelArg& arg : node.args )
+            {
+                if ( CLCommandGraph::NO_BUFFER != arg.buffer_index )
+                {
+                    setKernelArg(arg.index, &m_args[arg.buffer_index], sizeof(cl_mem));
+                }
+                else
+                {
+                    setKernelArg(arg.index, arg.value.data(), arg.value.size());
+                }
+            }
+            error = clEnqueueNDRangeKernel(m_cmdQueue, m_kernel, (cl_uint)node.global_size.size(), NULL,
+                node.global_size.data(), node.local_size.empty() ? NULL : node.local_size.data(),
+                (cl_uint)wait_list.size(), wait_list.empty() ? NULL : wait_list.data(), getProfilingEvent(&event));
+            checkCLError(error, "Enqueue NDRange Kernel Failed");
+            break;
+
+        case CLCommandGraph::NodeType::Read:
+            error = clEnqueueReadBuffer(m_cmdQueue, m_args[node.buffer_index], CL_FALSE, node.offset, node.len,
+                node.host_ptr, (cl_uint)wait_list.size(), wait_list.empty() ? NULL : wait_list.data(), getProfilingEvent(&event));
+            checkCLError(error, "Enqueue Read Buffer Failed");
+            break;
+        }
+
+        if ( nullptr != event )
+        {
+            clRetainEvent(event);   // the profiler and m_lastEvent keep their own reference
+            events[i] = CLEvent(event);
+        }
+        recordProfilingEvent(event, CLCommandGraph::NodeType::Kernel == node.type ? m_kernelName :
+            "buffer " + std::to_string(node.buffer_index),
+            CLCommandGraph::NodeType::Kernel == node.type ? "kernel" : CLCommandGraph::NodeType::Read == node.type ? "read" : "write");
+    }
+
+    // single host synchronization for the whole graph
+    if ( m_isOutOfOrder )
+    {
+        CLEvent::waitAll(events);
+        m_lastEvent = CLEvent();
+    }
+    else
+    {
+        error = clFinish(m_cmdQueue);
+        checkCLError(error, "Finish Command Queue Failed");
+    }
+
+    m_kernel = current_kernel;
+    m_kernelName = current_kernel_name;
+}
+
+void CLSimpleWrapper::executeKernelStream(const void* input, size_t count, size_t input_elem_size, size_t output_elem_size,
+    size_t chunk_size, unsigned int input_index, unsigned int output_index,
+    StreamCallback callback, size_t buffer_count)
+{
+    ensureKernels();
+
+    cl_int error = CL_SUCCESS;
+    if ( 0 == count )
+    {
+        return;
+    }
+    chunk_size = std::max<size_t>(1, std::min(chunk_size, count));
+    buffer_count = std::max<size_t>(1, buffer_count);
+    size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+
+    cl_command_queue upload_queue = m_session->getTransferQueue(0);
+    cl_command_queue readback_queue = m_session->getTransferQueue(1);
+
+    // device buffers and host staging of every slot
+    std::vector<cl_mem> inputs(buffer_count);
+    std::vector<cl_mem> outputs(buffer_count);
+    std::vector<std::vector<char> > staging(buffer_count, std::vector<char>(chunk_size * output_elem_size));
+    std::vector<CLEvent> read_events(buffer_count);
+    for ( size_t slot = 0; slot < buffer_count; slot++ )
+    {
+        inputs[slot] = m_bufferPool.acquire(chunk_size * input_elem_size, CL_MEM_READ_ONLY, &error);
+        checkCLError(error, "Create Buffer Failed");
+        outputs[slot] = m_bufferPool.acquire(chunk_size * output_elem_size, CL_MEM_WRITE_ONLY, &error);
+        checkCLError(error, "Create Buffer Failed");
+    }
+
+    // the readback waits for the kernel, so once delivered both buffers of the slot are free again.
+    auto deliver = [&](size_t chunk)
+    {
+        size_t slot = chunk % buffer_count;
+        size_t first = chunk * chunk_size;
+        read_events[slot].wait();
+        read_events[slot] = CLEvent();
+        callback(chunk, first, std::min(chunk_size, count - first), staging[slot].data());
+    };
+
+    for ( size_t chunk = 0; chunk < chunk_count; chunk++ )
+    {
+        size_t slot = chunk % buffer_count;
+        size_t first = chunk * chunk_size;
+        size_t elements = std::min(chunk_size, count - first);
+        if ( chunk >= buffer_count )
+        {
+            deliver(chunk - buffer_count);
+        }
+
+        cl_event write_event = nullptr;
+        error = clEnqueueWriteBuffer(upload_queue, inputs[slot], CL_FALSE, 0, elements * input_elem_size,
+            (const char*)input + first * input_elem_size, 0, NULL, &write_event);
+        checkCLError(error, "Enqueue Write Buffer Failed");
+        m_profiler.recordEvent(write_event, "buffer " + std::to_string(input_index), "write");
+        clFlush(upload_queue);
+
+        setKernelArg(input_index, &inputs[slot], sizeof(cl_mem));
+        setKernelArg(output_index, &outputs[slot], sizeof(cl_mem));
+
+        cl_event kernel_event = nullptr;
+        error = clEnqueueNDRangeKernel(m_cmdQueue, m_kernel, 1, NULL, &elements, NULL,
+            1, &write_event, &kernel_event);
+        checkCLError(error, "Enqueue NDRange Kernel Failed");
+        m_profiler.recordEvent(kernel_event, m_kernelName, "kernel");
+        clFlush(m_cmdQueue);
+
+        cl_event read_event = nullptr;
+        error = clEnqueueReadBuffer(readback_queue, outputs[slot], CL_FALSE, 0, elements * output_elem_size,
+            staging[slot].data(), 1, &kernel_event, &read_event);
+        checkCLError(error, "Enqueue Read Buffer Failed");
+        m_profiler.recordEvent(read_event, "buffer " + std::to_string(output_index), "read");
+        clFlush(readback_queue);
+
+        clReleaseEvent(write_event);
+        clReleaseEvent(kernel_event);
+        read_events[slot] = CLEvent(read_event);
+    }
+
+    for ( size_t chunk = (chunk_count > buffer_count ? chunk_count - buffer_count : 0); chunk < chunk_count; chunk++ )
+    {
+        deliver(chunk);
+    }
+
+    for ( size_t slot = 0; slot < buffer_count; slot++ )
+    {
+        m_bufferPool.release(inputs[slot]);
+        m_bufferPool.release(outputs[slot]);
+    }
+}
+
+void CLSimpleWrapper::enableAutotune(bool enable)
+{
+    m_isAutotuneEnabled = enable;
+}
+
+void CLSimpleWrapper::setTuningFile(std::string path)
+{
+    m_autotuner.setTuningFile(path);
+}
+
+std::vector<size_t> CLSimpleWrapper::autotuneLocalSize(size_t workSize, size_t* globalItemSize, size_t repeats)
+{
+    ensureKernels();
+
+    cl_int error = CL_SUCCESS;
+
+    size_t max_work_group_size = 0;
+    size_t preferred_multiple = 1;
+    size_t max_work_item_sizes[3] = { 0, 0, 0 };
+    error = clGetKernelWorkGroupInfo(m_kernel, m_device, CL_KERNEL_WORK_GROUP_SIZE,
+        sizeof(size_t), &max_work_group_size, nullptr);
+    checkCLError(error, "Get Kernel Work Group Info Failed");
+    clGetKernelWorkGroupInfo(m_kernel, m_device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE,
+        sizeof(size_t), &preferred_multiple, nullptr);
+    clGetDeviceInfo(m_device, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(max_work_item_sizes), max_work_item_sizes, nullptr);
+
+    std::vector<std::vector<size_t> > candidates = CLAutotuner::getCandidates(workSize, globalItemSize,
+        max_work_group_size, std::max<size_t>(preferred_multiple, 1), max_work_item_sizes);
+    candidates.insert(candidates.begin(), std::vector<size_t>());  // driver default
+
+    std::vector<size_t> best;
+    double best_time = -1.0;
+    std::vector<cl_event> order = getOrderWaitList();   // arguments written by the previous commands
+    for ( std::vector<size_t>& candidate : candidates )
+    {
+        size_t* local = candidate.empty() ? NULL : candidate.data();
+
+        // first run is a warm up, the best of the following ones is kept.
+        double candidate_time = -1.0;
+        for ( size_t run = 0; run <= repeats; run++ )
+        {
+            auto start = std::chrono::steady_clock::now();
+            error = clEnqueueNDRangeKernel(m_cmdQueue, m_kernel, (cl_uint)workSize,
+                NULL, globalItemSize, local, (cl_uint)order.size(), order.empty() ? NULL : order.data(), NULL);
+            if ( error != CL_SUCCESS )
+            {
+                break;  // i.e. out of resources with this work group size, skip the candidate
+            }
+            clFinish(m_cmdQueue);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            if ( run > 0 && (candidate_time < 0.0 || elapsed.count() < candidate_time) )
+            {
+                candidate_time = elapsed.count();
+            }
+        }
+
+        if ( candidate_time >= 0.0 && (best_time < 0.0 || candidate_time < best_time) )
+        {
+            best_time = candidate_time;
+            best = candidate;
+        }
+    }
+
+    m_autotuner.store(CLAutotuner::makeKey(m_kernelName, m_session->getDeviceSignature(), workSize, globalItemSize), best);
+    return best;
+}
+
+std::vector<CLCommandGraph::KernelArg> CLSimpleWrapper::getRecordedArgs()
+{
+    std::vector<CLCommandGraph::KernelArg> args;
+    const std::vector<std::vector<char> >& values = m_argValues[m_kernel];
+    for ( unsigned int index = 0; index < values.size(); index++ )
+    {
+        if ( values[index].empty() )
+        {
+            continue;   // not set, or a __local size: kept as set on the kernel
+        }
+
+        CLCommandGraph::KernelArg arg = { index, values[index], CLCommandGraph::NO_BUFFER };
+        for ( size_t i = 0; i < m_args.size() && values[index].size() == sizeof(cl_mem); i++ )
+        {
+            if ( nullptr != m_args[i] && 0 == std::memcmp(values[index].data(), &m_args[i], sizeof(cl_mem)) )
+            {
+                arg.buffer_index = i;
+                break;
+            }
+        }
+        args.push_back(arg);
+    }
+    return args;
+}
+
+size_t* CLSimpleWrapper::getLaunchLocalSize(size_t workSize, size_t* globalItemSize, size_t* localItemSize, std::vector<size_t>& tuned)
+{
+    if ( nullptr != localItemSize || !m_isAutotuneEnabled )
+    {
+        return localItemSize;
+    }
+
+    std::string key = CLAutotuner::makeKey(m_kernelName, m_session->getDeviceSignature(), workSize, globalItemSize);
+    if ( !m_autotuner.find(key, tuned) )
+    {
+        tuned = autotuneLocalSize(workSize, globalItemSize);
+    }
+    return tuned.empty() ? NULL : tuned.data();
+}
+
+void CLSimpleWrapper::enableProfiling(bool enable)
+{
+    m_profiler.setEnabled(enable);
+}
+
+std::vector<CLProfileStats> CLSimpleWrapper::getProfilingStats()
+{
+    return m_profiler.getStats();
+}
+
+bool CLSimpleWrapper::writeProfilingTrace(std::string path)
+{
+    return m_profiler.writeChromeTrace(path);
+}
+
+void CLSimpleWrapper::resetProfiling()
+{
+    m_profiler.reset();
+}
+
+cl_event* CLSimpleWrapper::getProfilingEvent(cl_event* event)
+{
+    return (m_profiler.isEnabled() || m_isOutOfOrder) ? event : NULL;
+}
+
+void CLSimpleWrapper::recordProfilingEvent(cl_event event, const std::string& name, const std::string& category)
+{
+    if ( nullptr != event )
+    {
+        m_profiler.recordEvent(event, name, category);
+        if ( m_isOutOfOrder )
+        {
+            m_lastEvent = CLEvent(event);   // the next synchronous command waits for it
+        }
+        else
+        {
+            clReleaseEvent(event);
+        }
+    }
+}
+
+std::vector<cl_event> CLSimpleWrapper::getOrderWaitList() const
+{
+    std::vector<cl_event> wait_list;
+    if ( m_isOutOfOrder && m_lastEvent.isValid() )
+    {
+        wait_list.push_back(m_lastEvent.get());
+    }
+    return wait_list;
+}
+
+std::string CLSimpleWrapper::getProgramCacheKey(const std::string& kernel_source_str, const std::string& build_options)
+{
+    return CLProgramCache::hash(kernel_source_str + '\0' + build_options + '\0' + m_session->getDeviceSignature());
+}
+
+void CLSimpleWrapper::clear()
+{
+    cl_int error = CL_SUCCESS;
+    for ( cl_command_queue queue : m_cmdQueues )
+    {
+        error = clFlush(queue);
+        error = clFinish(queue);
+    }
+    if ( nullptr != m_cmdQueue )
+    {
+        error = clFinish(m_cmdQueue);  // queue from the session pool
+    }
+    m_splitEvents.clear();
+    m_lastEvent = CLEvent();
+
+    for ( auto& kernel : m_kernels )
+    {
+        error = clReleaseKernel(kernel.second);
+    }
+    m_kernels.clear();
+    for ( auto& variant : m_variants )
+    {
+        error = clReleaseKernel(variant.second.kernel);
+        error = clReleaseProgram(variant.second.program);
+    }
+    m_variants.clear();
+    m_sourceHashes.clear();
+    m_kernel = nullptr;
+    m_argValues.clear();
+
+    for ( cl_program program : m_programs )
+    {
+        error = clReleaseProgram(program);
+    }
+    m_programs.clear();
+    m_pendingKernels.clear();
 
-    for ( cl_mem arg : m_args )
+    for ( unsigned int i = 0; i < m_args.size(); i++ )
     {
-        error = clReleaseMemObject(arg);
+        releaseKernelBufferArg(i);
     }
     m_args.clear();
+    m_splitArgs.clear();
+    m_bufferPool.releaseAll();
 
-    error = clReleaseCommandQueue(m_cmdQueue);
-    error = clReleaseContext(m_context);
+    // context and queues are owned by the session, released with the last wrapper using it.
+    m_cmdQueues.clear();
+    m_devices.clear();
+    m_cmdQueue = nullptr;
+    m_context = nullptr;
+    m_device = nullptr;
+    m_session.reset();
 }
 
 void CLSimpleWrapper::checkCLError(cl_int error, std::string err_msg)
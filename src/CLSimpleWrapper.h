@@ -2,37 +2,194 @@
 
 #include <vector>
 #include <string>
+#include <map>
+#include <memory>
+#include <functional>
 
-#define CL_TARGET_OPENCL_VERSION 120
-//#define _CL_CPP   // not using OpenCL C++ binding for now
+#include "CLConfig.h"
+#include "CLSession.h"
+#include "CLProgramCache.h"
+#include "CLBufferPool.h"
+#include "CLEvent.h"
+#include "CLProfiler.h"
+#include "CLAutotuner.h"
+#include "CLBatchJob.h"
+#include "CLCommandGraph.h"
+#include "CLBuildHandle.h"
 
-#include <CL/opencl.h>
-#ifdef _CL_CPP
-#define CL_HPP_TARGET_OPENCL_VERSION 120
-#define CL_HPP_MINIMUM_OPENCL_VERSION 120
-#include "CL/opencl.hpp"	// if using C++ binding
-#endif
+// host allocations used with CL_MEM_USE_HOST_PTR must be page aligned to be zero-copy
+#define CL_HOST_BUFFER_ALIGNMENT 4096
+
+// file input is uploaded in chunks of this size, only one or two chunks are resident in host memory at a time
+#define CL_FILE_CHUNK_SIZE (16 * 1024 * 1024)
 
 class CLSimpleWrapper
 {
 public:
+    enum class BufferMode
+    {
+        Copy,       // device buffers, host data is copied in and out (default)
+        HostMapped  // host visible buffers (CL_MEM_USE_HOST_PTR / CL_MEM_ALLOC_HOST_PTR), accessed with mapBuffer()
+    };
+
+    enum class SplitPolicy
+    {
+        Static,     // split ratios set with setSplitRatios(), equal by default
+        Throughput  // ratios updated after every executeKernelSplit() from the measured device throughput
+    };
+
+    // called on the host thread for every completed chunk of executeKernelStream(), in chunk order.
+    //  output holds the count results of the elements [first, first + count), it is only valid during the call.
+    typedef std::function<void(size_t chunk_index, size_t first, size_t count, const void* output)> StreamCallback;
+
     CLSimpleWrapper();
+
+    // use an existing (i.e. CLSession::getShared()) session instead of initOpenCL(), context and queue are shared.
+    //  the queue is taken from the session queue pool when there is one (see CLSession::createQueuePool()).
+    explicit CLSimpleWrapper(std::shared_ptr<CLSession> session);
+
     ~CLSimpleWrapper();
 
+    // create a private session on the selected platform and device, or only print them if is_list_only.
     void initOpenCL(int platformId = -1, int deviceId = -1, bool is_list_only = true);
 
-    cl_int createCLKernel(std::string& kernel_source_str, std::string prog_name);
+    // create a single context over all the devices of device_type within the platform, with a command queue per device.
+    //  the first device is used by the single device calls (executeKernel(), readBuffer(), ...),
+    //  executeKernelSplit() partitions the global range across all of them.
+    void initOpenCLMultiDevice(int platformId = -1, cl_device_type device_type = CL_DEVICE_TYPE_ALL);
+
+    // a wrapper is not thread safe (clSetKernelArg() on a shared kernel races), use one per host thread instead:
+    //  the clone shares the session and the built programs, with its own kernel instances, arguments and queue.
+    //  profiling, buffer mode and the current kernel are kept, arguments must be set again.
+    std::unique_ptr<CLSimpleWrapper> clone() const;
+
+    size_t getDeviceCount() const;
+
+    std::shared_ptr<CLSession> getSession() const;
+
+    // build the program and create every __kernel it contains, prog_name is selected as current kernel.
+    //  calling it again with another source adds the kernels of the new program to the registry.
+    cl_int createCLKernel(std::string& kernel_source_str, std::string prog_name, std::string build_options = "");
+
+    cl_int createCLKernelFromFile(std::string kernel_file_path, std::string prog_name, std::string build_options = "");
+
+    // same as createCLKernel(), but the program is built on a worker thread and the call returns at once.
+    //  The kernels are created when first needed: selectKernel(), setKernelArg() (and the buffer arguments),
+    //  executeKernel*() wait for the build, so that it overlaps the data loading. Call handle.wait() before
+    //  clone() or getKernelNames(), they only see the kernels already created. The kernels of a failed build are
+    //  not created, the error is returned by handle.wait().
+    CLBuildHandle createCLKernelAsync(std::string kernel_source_str, std::string prog_name, std::string build_options = "");
+
+    // start building every program in parallel (one worker thread each) into the session, without creating kernels:
+    //  a later createCLKernel() of the same source and options, by any wrapper of the session, waits for it
+    //  instead of building again. i.e. at startup, before the first request.
+    std::vector<CLBuildHandle> prebuildCLKernels(const std::vector<CLProgramSource>& programs);
+
+    // select the kernel prog_name of the source specialized with build_options (see makeBuildOptions()), built on first use.
+    //  i.e. a matrix size passed as -D define is constant-folded, so the compiler can fully unroll the loops over it.
+    //  variants are kept in memory by kernel name, build options and source: selecting a hot variant again is a map lookup.
+    //  The source is hashed on its first use only, then known by its address and size: don't edit it in place.
+    //  selectKernel() switches back to the kernels of createCLKernel().
+    cl_int selectKernelVariant(std::string& kernel_source_str, std::string prog_name, std::string build_options);
+
+    // "-D name=value" for every define (or "-D name" for an empty value), followed by the compiler flags,
+    //  i.e. makeBuildOptions({ { "T", "float" }, { "M", "1024" } }, "-cl-fast-relaxed-math -cl-mad-enable").
+    static std::string makeBuildOptions(const std::map<std::string, std::string>& defines, const std::string& flags = "");
+
+    // select the kernel used by setKernelArg(), setKernelBufferArg() and executeKernel(),
+    //  context, queue and buffers are shared between all the kernels.
+    cl_int selectKernel(std::string kernel_name);
+
+    std::vector<std::string> getKernelNames() const;
+
+    // bind the buffer of another argument index (i.e. set for a previous kernel) to the current kernel argument index.
+    void bindKernelBufferArg(unsigned int index, size_t buffer_index);
+
+    // record the device timings of every command enqueued by the wrapper and the program build times.
+    //  must be called before initOpenCL(), the queue is created with CL_QUEUE_PROFILING_ENABLE.
+    void enableProfiling(bool enable = true);
+
+    // count, total, min/max and percentiles of the execution time, per kernel name and per transfer.
+    std::vector<CLProfileStats> getProfilingStats();
+
+    // export every profiled command as Chrome trace (chrome://tracing) JSON file.
+    bool writeProfilingTrace(std::string path);
 
-    cl_int createCLKernelFromFile(std::string kernel_file_path, std::string prog_name);
+    void resetProfiling();
 
-    // note: we assume that args created in order
+    // enable the on-disk program binary cache used by createCLKernel(), the directory must exist.
+    void setProgramCacheDir(std::string cache_dir);
+
+    size_t getProgramCacheHits() const;
+
+    size_t getProgramCacheMisses() const;
+
+    // peak number of device buffer bytes in use, and ratio of buffers served without clCreateBuffer().
+    size_t getBufferPoolHighWaterMark() const;
+
+    double getBufferPoolReuseRate() const;
+
+    // buffers are kept by kernel argument index and taken from the buffer pool.
+    //  setting the same index again returns the previous buffer into the pool.
     void setKernelBufferArg(unsigned int index, void* buffer, size_t len);
 
+    // input buffer with len bytes of the file at offset (0: up to the end of the file, see CLMappedFile::getFileSize()),
+    //  the file is memory mapped instead of being read into a host array. In HostMapped mode the mapped pages are
+    //  used in place (CL_MEM_USE_HOST_PTR) when offset is page aligned, otherwise they are uploaded in chunks of
+    //  CL_FILE_CHUNK_SIZE. CL_INVALID_VALUE when the file can't be mapped.
+    cl_int setKernelBufferArgFromFile(unsigned int index, std::string file_path, size_t offset = 0, size_t len = 0);
+
+    // read-only input buffer kept on the device by the session residency cache (see CLResidencyCache): uploaded on
+    //  the first call, then bound without any transfer while it stays resident, by any wrapper of the session.
+    //  tag names the content, use another tag (or CLResidencyCache::remove()) when it changes. Without tag, the content
+    //  hash is the key: changed data is uploaded again, at the cost of hashing len bytes on every call. The hash is not
+    //  cryptographic, two contents of the same length colliding would silently bind the other data: use tags for
+    //  untrusted or adversarial inputs.
+    //  The kernels must not write the buffer. Not recorded by beginRecording(), the buffer is simply used on replay.
+    void setKernelResidentBufferArg(unsigned int index, const void* buffer, size_t len, const std::string& tag = "");
+
+    // device only read-write buffer, for intermediate results passed from one kernel to the next (see bindKernelBufferArg()).
+    void setKernelScratchBufferArg(unsigned int index, size_t len);
+
+    // device only read-write buffer kept at buffer_index without setting a kernel argument, bind it with bindKernelBufferArg().
+    //  for the intermediate buffers of multi-pass algorithms, that don't match the argument index of any kernel.
+    void createScratchBuffer(size_t buffer_index, size_t len);
+
+    // return the buffer bound to the argument index into the pool, without waiting for clear().
+    void releaseKernelBufferArg(unsigned int index);
+
+    // select how setKernelBufferArg() creates the buffers, applies to the buffers set afterward.
+    //  in HostMapped mode, a page aligned host buffer (see allocHostBuffer()) is used in place by the device,
+    //  which avoids every copy on CPU and integrated GPU devices.
+    void setBufferMode(BufferMode mode);
+
+    // map the buffer of the argument index into host memory, blocking until the data is available.
+    //  in HostMapped mode this is a direct pointer to the buffer without copy.
+    void* mapBuffer(size_t index, size_t len, cl_map_flags flags = CL_MAP_READ);
+
+    void unmapBuffer(size_t index, void* mapped_ptr);
+
+    // page aligned host allocation, suitable for zero-copy buffers in HostMapped mode.
+    static void* allocHostBuffer(size_t len);
+
+    static void freeHostBuffer(void* buffer);
+
     // generic implementation for setting OpenCL primitive type argument.
+    //  the last value of every argument is kept per kernel, setting the same value again skips clSetKernelArg().
     void setKernelArg(unsigned int index, const void* buffer, const size_t len);
 
-    // note: we assume that args created in order, caller is responsible to allocate the memory for outData.
-    void readBuffer(void* outData, size_t index, size_t len);
+    // write new data into the existing buffer of the argument index at offset (bytes), blocking.
+    //  unlike setKernelBufferArg(), no buffer is created and the kernel argument is untouched: the fast path to re-launch.
+    void writeBuffer(size_t index, const void* data, size_t len, size_t offset = 0);
+
+    // write a 2D/3D region (clEnqueueWriteBufferRect), i.e. a sub-matrix. origins and region are in bytes for x,
+    //  rows and slices for y and z, pitches are the bytes per row of the buffer and of the host data.
+    void writeBufferRect(size_t index, const void* data, const size_t* buffer_origin, const size_t* host_origin,
+        const size_t* region, size_t buffer_row_pitch, size_t host_row_pitch);
+
+    // note: index is the kernel argument index of the buffer, caller is responsible to allocate the memory for outData.
+    //  offset (bytes) reads only a sub-range of the buffer.
+    void readBuffer(void* outData, size_t index, size_t len, size_t offset = 0);
 
 
     // let caller to have control the global item size and local item size
@@ -40,24 +197,203 @@ public:
         size_t* globalItemSize,
         size_t* localItemSize);// Divide work items into groups of localItemSize
 
+    // output buffer with one copy per device, each device writes its own slice during executeKernelSplit().
+    //  input buffers are shared by all the devices, set them with setKernelBufferArg().
+    void setKernelSplitBufferArg(unsigned int index, size_t len);
+
+    // partition globalItemSize[split_dim] across the devices with the current split ratios, using global work offsets,
+    //  so the kernel sees the same global ids as with executeKernel(). i.e. split_dim 1 splits the matrix multiply by rows.
+    void executeKernelSplit(size_t workSize,
+        size_t* globalItemSize,
+        size_t* localItemSize,
+        size_t split_dim);
+
+    // gather the slice computed by each device into outData. slice_len is the number of bytes per unit of the split
+    //  dimension (i.e. one matrix row), blocking until every device is done.
+    void readBufferSplit(void* outData, size_t index, size_t slice_len);
+
+    void setSplitPolicy(SplitPolicy policy);
+
+    // one ratio per device, normalized internally.
+    void setSplitRatios(const std::vector<double>& ratios);
+
+    std::vector<double> getSplitRatios() const;
+
+    // [start, start + count) of the split dimension for each device, aligned to granularity, as used by
+    //  executeKernelSplit() with the normalized ratios. A device with a ratio of 0 gets an empty range.
+    static std::vector<std::pair<size_t, size_t> > getSplitRanges(const std::vector<double>& ratios,
+        size_t total, size_t granularity);
+
+    // when enabled, executeKernel() / executeKernelAsync() called with a NULL local size use the tuned one,
+    //  running autotuneLocalSize() on the first launch of a kernel / device / global size.
+    void enableAutotune(bool enable = true);
+
+    // tuned local sizes are loaded from and saved into this file, so later runs skip the search.
+    void setTuningFile(std::string path);
+
+    // benchmark the candidate local sizes (and the driver default) of the current kernel with its current arguments,
+    //  store and return the fastest one, empty for driver default. The kernel is run several times:
+    //  it must give the same result when run again (i.e. no in-place accumulation).
+    std::vector<size_t> autotuneLocalSize(size_t workSize, size_t* globalItemSize, size_t repeats = 3);
+
+    // exit with err_msg if error is not CL_SUCCESS.
+    static void checkCLError(cl_int error, std::string err_msg = "");
+
+    // asynchronous variants: the commands are only enqueued (and flushed), host thread is not blocked.
+    //  the returned event can be waited on, or passed in the wait_list of the next command,
+    //  so that launches, writes and reads are chained on the device without host round-trips.
+    //  on an out-of-order queue, the wait_list is the only ordering of the asynchronous commands.
+    CLEvent executeKernelAsync(size_t workSize,
+        size_t* globalItemSize,
+        size_t* localItemSize,
+        const std::vector<CLEvent>& wait_list = std::vector<CLEvent>());
+
+    // outData must stay valid until the returned event is completed.
+    CLEvent readBufferAsync(void* outData, size_t index, size_t len,
+        const std::vector<CLEvent>& wait_list = std::vector<CLEvent>());
+
+    // write into the existing buffer of the argument index, data must stay valid until the returned event is completed.
+    CLEvent writeBufferAsync(size_t index, const void* data, size_t len,
+        const std::vector<CLEvent>& wait_list = std::vector<CLEvent>());
+
+    // event completed when every event of the list is completed (clEnqueueMarkerWithWaitList).
+    CLEvent whenAll(const std::vector<CLEvent>& events);
+
+    // block until every event of the list is completed.
+    void wait(const std::vector<CLEvent>& events);
+
+    // block until every command enqueued so far is completed.
+    void finish();
+
+    // launch every job back to back, with a single upload of the packed inputs, a single download of the packed outputs,
+    //  and a single host synchronization at the end. The inputs and outputs of the jobs are sub-buffers of one buffer each,
+    //  aligned to CL_DEVICE_MEM_BASE_ADDR_ALIGN. The current kernel is restored afterward.
+    void executeBatch(const std::vector<CLBatchJob>& jobs);
+
+    // capture the synchronous writes (writeBuffer(), writeBufferRect(), setKernelBufferArg() with host data), kernel launches
+    //  (executeKernel(), with every argument value) and reads (readBuffer()) into graph until endRecording().
+    //  The commands are still executed, so the recorded iteration is a normal one.
+    void beginRecording(CLCommandGraph& graph);
+
+    void endRecording();
+
+    // enqueue every node of the graph without blocking, the arguments that differ from the kernel state are set
+    //  again, and wait once for the whole graph. The host arrays of the writes and reads are those of the graph,
+    //  see CLCommandGraph::patchHostPointer(). The current kernel is restored afterward.
+    void replay(const CLCommandGraph& graph);
+
+    // out-of-core execution of the current kernel over count elements of input, chunk_size elements at a time.
+    //  buffer_count device buffers (2: double buffering, 3: triple buffering) are rotated, so that the upload of
+    //  chunk N+1 and the readback of chunk N-1 (on the session transfer queues) overlap the kernel of chunk N.
+    //  The kernel is launched with a 1D global size of the chunk element count, with the chunk buffers bound to
+    //  input_index and output_index, other arguments are set beforehand. Returns once every chunk is delivered.
+    void executeKernelStream(const void* input, size_t count, size_t input_elem_size, size_t output_elem_size,
+        size_t chunk_size, unsigned int input_index, unsigned int output_index,
+        StreamCallback callback, size_t buffer_count = 2);
+
 private:
-    std::string GetPlatformName(cl_platform_id id);
+    void attachSession(std::shared_ptr<CLSession> session);
+
+    // build the program from the session, the program cache or the source. program is owned by the caller.
+    cl_int buildProgram(std::string& kernel_source_str, const std::string& prog_name,
+        const std::string& build_options, cl_program& program);
 
-    std::string GetDeviceName(cl_device_id id);
+    // load the program from the program cache, or start its build on a worker thread (storing it in the cache).
+    CLBuildHandle startBuild(const std::string& kernel_source_str, const std::string& build_options);
+
+    // create the kernels of createCLKernelAsync(), waiting for their build. Returns the first error, the failed
+    //  builds are dropped.
+    cl_int ensureKernels();
+
+    // create every kernel of the program into the registry.
+    void createKernels(cl_program program);
+
+    // drop the cached kernel argument values holding the buffer, before it is released: a new buffer may get the same handle.
+    void invalidateKernelArg(cl_mem buffer);
+
+    // hash of everything that affects the program binary, used as program cache key
+    std::string getProgramCacheKey(const std::string& kernel_source_str, const std::string& build_options);
+
+    // event output of the synchronous enqueue calls, NULL when profiling is disabled and the queue is in-order,
+    //  so that no event is created.
+    cl_event* getProfilingEvent(cl_event* event);
+
+    // record the event of a synchronous enqueue into the profiler, and release it
+    //  (or keep it as the last command on an out-of-order queue).
+    void recordProfilingEvent(cl_event event, const std::string& name, const std::string& category);
+
+    // wait list of the synchronous enqueue calls: on an out-of-order queue, the last command enqueued by this wrapper,
+    //  so that they keep the in-order semantic while the commands of other wrappers run concurrently.
+    std::vector<cl_event> getOrderWaitList() const;
+
+    // throughput weighted ratios from the kernel events of the last executeKernelSplit().
+    void updateSplitRatios();
+
+    // every argument value set on the current kernel, with the buffer index of the buffer arguments.
+    std::vector<CLCommandGraph::KernelArg> getRecordedArgs();
+
+    // local size to launch with: localItemSize if set, the tuned one if autotune is enabled, or NULL.
+    size_t* getLaunchLocalSize(size_t workSize, size_t* globalItemSize, size_t* localItemSize, std::vector<size_t>& tuned);
 
     void clear();
 
-    void checkCLError(cl_int error, std::string err_msg = "");
 
+    std::shared_ptr<CLSession> m_session;
 
     cl_device_id m_device;
     cl_context m_context;
 
-    cl_kernel m_kernel;
-    cl_program m_program;
+    cl_kernel m_kernel;     // current kernel, owned by m_kernels
+    std::string m_kernelName;
+    std::map<std::string, cl_kernel> m_kernels;  // every kernel of the built programs by name
+    std::vector<cl_program> m_programs;
+
+    struct PendingKernel
+    {
+        std::string source;
+        std::string prog_name;
+        std::string build_options;
+        CLBuildHandle build;
+    };
+    std::vector<PendingKernel> m_pendingKernels;    // createCLKernelAsync() not created yet, in call order
+
+    struct KernelVariant
+    {
+        cl_program program;
+        cl_kernel kernel;
+        std::string function_name;
+        std::string name;   // function name with the hash of the source and the build options
+    };
+    std::map<std::string, KernelVariant> m_variants;   // by kernel name, build options and source hash
+    std::map<std::pair<const char*, size_t>, std::string> m_sourceHashes;   // selectKernelVariant() sources by address and size
     cl_command_queue m_cmdQueue;
+    bool m_isOutOfOrder;    // m_cmdQueue is created with CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE
+    CLEvent m_lastEvent;    // last synchronous command, out-of-order queue only
+
+    std::vector<cl_device_id> m_devices;            // every device of the context, m_device is the first one
+    std::vector<cl_command_queue> m_cmdQueues;      // one per device, m_cmdQueue is the first one
+
+    std::vector<cl_mem > m_args;   // indexed by kernel argument index, nullptr for non-buffer args
+    std::map<cl_kernel, std::vector<std::vector<char> > > m_argValues;   // last value set per kernel and argument index
+    std::map<unsigned int, std::vector<cl_mem> > m_splitArgs;  // per device copies of the split output buffers
+
+    SplitPolicy m_splitPolicy;
+    std::vector<double> m_splitRatios;
+    std::vector<std::pair<size_t, size_t> > m_splitRanges;  // ranges of the last executeKernelSplit()
+    std::vector<CLEvent> m_splitEvents;                     // kernel event per device of the last executeKernelSplit()
+
+    CLBufferPool m_bufferPool;
+
+    CLProgramCache m_programCache;
+
+    BufferMode m_bufferMode;
+
+    CLProfiler m_profiler;
+
+    bool m_isAutotuneEnabled;
+    CLAutotuner m_autotuner;
 
-    std::vector<cl_mem > m_args;
+    CLCommandGraph* m_recording;    // graph being recorded, nullptr when not recording
 
 };
 
@@ -0,0 +1,335 @@
+#include <string>
+
+#include "CLSparse.h"
+
+// work group size of the SpMV kernels, largest vector width of spmvCsrVector
+#define SPARSE_WG 256
+#define SPARSE_MAX_VECTOR_WIDTH 32
+
+// ScalarRow is selected up to this mean row length, when no row is longer than SPARSE_SCALAR_SKEW times the mean
+#define SPARSE_SCALAR_MEAN 4.0
+#define SPARSE_SCALAR_SKEW 8.0
+
+// built once per element type (and vector width) with -D T=<type> -D VW=<width>, USE_FP64 enables double precision.
+static const std::string ClSrcSparse = R"CLC(
+#ifdef USE_FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+// one work item per row
+__kernel void spmvCsrScalar(const uint rows,
+    __global const uint* row_offsets, __global const uint* col_indices, __global const T* values,
+    __global const T* x, __global T* y)
+{
+    const uint row = get_global_id(0);
+    if ( row >= rows )
+    {
+        return;
+    }
+
+    T sum = 0;
+    const uint end = row_offsets[row + 1];
+    for ( uint i = row_offsets[row]; i < end; i++ )
+    {
+        sum += values[i] * x[col_indices[i]];
+    }
+    y[row] = sum;
+}
+
+// VW consecutive work items per row, local size WG: the nonzeros of a row are read together along the row,
+//  and the partial sums reduced in __local memory.
+__kernel void spmvCsrVector(const uint rows,
+    __global const uint* row_offsets, __global const uint* col_indices, __global const T* values,
+    __global const T* x, __global T* y)
+{
+    __local T partial[WG];
+
+    const uint lid = get_local_id(0);
+    const uint lane = lid % VW;
+    const uint row = get_global_id(0) / VW;
+
+    T sum = 0;
+    if ( row < rows )
+    {
+        const uint end = row_offsets[row + 1];
+        for ( uint i = row_offsets[row] + lane; i < end; i += VW )
+        {
+            sum += values[i] * x[col_indices[i]];
+        }
+    }
+    partial[lid] = sum;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for ( uint offset = VW / 2; offset > 0; offset >>= 1 )
+    {
+        if ( lane < offset )
+        {
+            partial[lid] += partial[lid + offset];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if ( 0 == lane && row < rows )
+    {
+        y[row] = partial[lid];
+    }
+}
+
+// one work item per row, entry j of the row at slice_offsets[slice] + j * slice_height + row % slice_height
+__kernel void spmvEll(const uint rows, const uint slice_height, __global const uint* slice_offsets,
+    __global const uint* col_indices, __global const T* values,
+    __global const T* x, __global T* y)
+{
+    const uint row = get_global_id(0);
+    if ( row >= rows )
+    {
+        return;
+    }
+
+    const uint slice = row / slice_height;
+    const uint begin = slice_offsets[slice] + row % slice_height;
+    const uint end = slice_offsets[slice + 1];
+
+    T sum = 0;
+    for ( uint i = begin; i < end; i += slice_height )
+    {
+        sum += values[i] * x[col_indices[i]];     // padding: value 0, column 0
+    }
+    y[row] = sum;
+}
+
+// global size (N, rows): neighbor work items compute neighbor columns of a row of C, reading B along its rows.
+__kernel void spmmCsr(const uint rows, const uint N,
+    __global const uint* row_offsets, __global const uint* col_indices, __global const T* values,
+    __global const T* B, __global T* C)
+{
+    const uint col = get_global_id(0);
+    const uint row = get_global_id(1);
+    if ( row >= rows || col >= N )
+    {
+        return;
+    }
+
+    T sum = 0;
+    const uint end = row_offsets[row + 1];
+    for ( uint i = row_offsets[row]; i < end; i++ )
+    {
+        sum += values[i] * B[col_indices[i] * N + col];
+    }
+    C[row * N + col] = sum;
+}
+)CLC";
+
+static size_t roundUp(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+CLSparse::CLSparse(std::shared_ptr<CLSession> session)
+    : m_source(ClSrcSparse),
+    m_wrapper(session)
+{
+
+}
+
+void CLSparse::spmv(const Csr<float>& a, const float* x, float* y, SpmvKernel kernel)
+{
+    runSpmv(a, x, y, kernel, "float");
+}
+
+void CLSparse::spmv(const Csr<double>& a, const double* x, double* y, SpmvKernel kernel)
+{
+    runSpmv(a, x, y, kernel, "double");
+}
+
+void CLSparse::spmv(const Ell<float>& a, const float* x, float* y)
+{
+    runSpmvEll(a, x, y, "float");
+}
+
+void CLSparse::spmv(const Ell<double>& a, const double* x, double* y)
+{
+    runSpmvEll(a, x, y, "double");
+}
+
+void CLSparse::spmm(const Csr<float>& a, const float* b, float* c, size_t N)
+{
+    runSpmm(a, b, c, N, "float");
+}
+
+void CLSparse::spmm(const Csr<double>& a, const double* b, double* c, size_t N)
+{
+    runSpmm(a, b, c, N, "double");
+}
+
+void CLSparse::enableProfiling(bool enable)
+{
+    m_wrapper.enableProfiling(enable);
+}
+
+CLSimpleWrapper& CLSparse::getWrapper()
+{
+    return m_wrapper;
+}
+
+CLSparse::RowStats CLSparse::getRowStats(const std::vector<cl_uint>& row_offsets)
+{
+    RowStats stats = RowStats();
+    size_t rows = row_offsets.empty() ? 0 : row_offsets.size() - 1;
+    if ( 0 == rows )
+    {
+        return stats;
+    }
+
+    stats.min_length = row_offsets[1] - row_offsets[0];
+    double sum_squares = 0;
+    for ( size_t row = 0; row < rows; row++ )
+    {
+        size_t length = row_offsets[row + 1] - row_offsets[row];
+        stats.min_length = std::min(stats.min_length, length);
+        stats.max_length = std::max(stats.max_length, length);
+        sum_squares += (double)length * length;
+    }
+    stats.mean_length = (double)row_offsets[rows] / rows;
+    stats.stddev = std::sqrt(std::max(0.0, sum_squares / rows - stats.mean_length * stats.mean_length));
+    return stats;
+}
+
+CLSparse::SpmvKernel CLSparse::selectSpmvKernel(const RowStats& stats)
+{
+    // a vector of work items per row only pays off when there are enough nonzeros to share,
+    //  or when a few long rows would keep the rest of a scalar work group waiting
+    if ( stats.mean_length <= SPARSE_SCALAR_MEAN &&
+        stats.max_length <= SPARSE_SCALAR_SKEW * std::max(1.0, stats.mean_length) )
+    {
+        return SpmvKernel::ScalarRow;
+    }
+    return SpmvKernel::VectorRow;
+}
+
+size_t CLSparse::getVectorWidth(const RowStats& stats)
+{
+    size_t width = 2;
+    while ( width < stats.mean_length && width < SPARSE_MAX_VECTOR_WIDTH )
+    {
+        width *= 2;
+    }
+    return width;
+}
+
+void CLSparse::selectKernel(const std::string& type_name, const std::string& kernel_name, size_t vector_width)
+{
+    std::map<std::string, std::string> defines;
+    defines["T"] = type_name;
+    defines["WG"] = std::to_string(SPARSE_WG);
+    defines["VW"] = std::to_string(vector_width);
+    if ( type_name == "double" )
+    {
+        defines["USE_FP64"] = "";
+    }
+
+    cl_int error = m_wrapper.selectKernelVariant(m_source, kernel_name, CLSimpleWrapper::makeBuildOptions(defines));
+    CLSimpleWrapper::checkCLError(error, "Build Sparse Program Failed");
+}
+
+template<typename T>
+void CLSparse::runSpmv(const Csr<T>& a, const T* x, T* y, SpmvKernel kernel, const std::string& type_name)
+{
+    // no nonzero: nothing to upload
+    if ( a.values.empty() )
+    {
+        std::fill(y, y + a.rows, (T)0);
+        return;
+    }
+
+    size_t vector_width = 1;
+    if ( SpmvKernel::Auto == kernel )
+    {
+        RowStats stats = getRowStats(a.row_offsets);
+        kernel = selectSpmvKernel(stats);
+        vector_width = getVectorWidth(stats);
+    }
+    else if ( SpmvKernel::VectorRow == kernel )
+    {
+        vector_width = getVectorWidth(getRowStats(a.row_offsets));
+    }
+
+    if ( SpmvKernel::ScalarRow == kernel )
+    {
+        selectKernel(type_name, "spmvCsrScalar");
+        vector_width = 1;
+    }
+    else
+    {
+        selectKernel(type_name, "spmvCsrVector", vector_width);
+    }
+
+    cl_uint rows = (cl_uint)a.rows;
+    m_wrapper.setKernelArg(0, &rows, sizeof(cl_uint));
+    m_wrapper.setKernelBufferArg(1, (void*)a.row_offsets.data(), a.row_offsets.size() * sizeof(cl_uint));
+    m_wrapper.setKernelBufferArg(2, (void*)a.col_indices.data(), a.col_indices.size() * sizeof(cl_uint));
+    m_wrapper.setKernelBufferArg(3, (void*)a.values.data(), a.values.size() * sizeof(T));
+    m_wrapper.setKernelBufferArg(4, (void*)x, a.cols * sizeof(T));
+    m_wrapper.setKernelBufferArg(5, nullptr, a.rows * sizeof(T));
+
+    size_t global_item_size = roundUp(a.rows * vector_width, SPARSE_WG);
+    size_t local_item_size = SPARSE_WG;
+    m_wrapper.executeKernel(1, &global_item_size, &local_item_size);
+
+    m_wrapper.readBuffer(y, 5, a.rows * sizeof(T));
+}
+
+template<typename T>
+void CLSparse::runSpmvEll(const Ell<T>& a, const T* x, T* y, const std::string& type_name)
+{
+    if ( a.values.empty() )
+    {
+        std::fill(y, y + a.rows, (T)0);
+        return;
+    }
+
+    selectKernel(type_name, "spmvEll");
+
+    cl_uint rows = (cl_uint)a.rows;
+    cl_uint slice_height = (cl_uint)a.slice_height;
+    m_wrapper.setKernelArg(0, &rows, sizeof(cl_uint));
+    m_wrapper.setKernelArg(1, &slice_height, sizeof(cl_uint));
+    m_wrapper.setKernelBufferArg(2, (void*)a.slice_offsets.data(), a.slice_offsets.size() * sizeof(cl_uint));
+    m_wrapper.setKernelBufferArg(3, (void*)a.col_indices.data(), a.col_indices.size() * sizeof(cl_uint));
+    m_wrapper.setKernelBufferArg(4, (void*)a.values.data(), a.values.size() * sizeof(T));
+    m_wrapper.setKernelBufferArg(5, (void*)x, a.cols * sizeof(T));
+    m_wrapper.setKernelBufferArg(6, nullptr, a.rows * sizeof(T));
+
+    size_t global_item_size = roundUp(a.rows, SPARSE_WG);
+    size_t local_item_size = SPARSE_WG;
+    m_wrapper.executeKernel(1, &global_item_size, &local_item_size);
+
+    m_wrapper.readBuffer(y, 6, a.rows * sizeof(T));
+}
+
+template<typename T>
+void CLSparse::runSpmm(const Csr<T>& a, const T* b, T* c, size_t N, const std::string& type_name)
+{
+    if ( a.values.empty() || 0 == N )
+    {
+        std::fill(c, c + a.rows * N, (T)0);
+        return;
+    }
+
+    selectKernel(type_name, "spmmCsr");
+
+    cl_uint rows = (cl_uint)a.rows;
+    cl_uint n = (cl_uint)N;
+    m_wrapper.setKernelArg(0, &rows, sizeof(cl_uint));
+    m_wrapper.setKernelArg(1, &n, sizeof(cl_uint));
+    m_wrapper.setKernelBufferArg(2, (void*)a.row_offsets.data(), a.row_offsets.size() * sizeof(cl_uint));
+    m_wrapper.setKernelBufferArg(3, (void*)a.col_indices.data(), a.col_indices.size() * sizeof(cl_uint));
+    m_wrapper.setKernelBufferArg(4, (void*)a.values.data(), a.values.size() * sizeof(T));
+    m_wrapper.setKernelBufferArg(5, (void*)b, a.cols * N * sizeof(T));
+    m_wrapper.setKernelBufferArg(6, nullptr, a.rows * N * sizeof(T));
+
+    size_t global_item_size[2] = { N, a.rows };
+    m_wrapper.executeKernel(2, global_item_size, NULL);
+
+    m_wrapper.readBuffer(c, 6, a.rows * N * sizeof(T));
+}
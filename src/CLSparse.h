@@ -0,0 +1,256 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+
+#include "CLSimpleWrapper.h"
+
+// Sparse matrix products on top of CLSimpleWrapper, for float and double: y = A * x (SpMV) and C = A * B (SpMM)
+//  with A sparse and x, B dense. A is stored in CSR, ELL or sliced ELL, converted on the host (see fromDense(),
+//  fromCoo(), toEll()). The CSR SpMV kernel is chosen from the row length statistics of A: one work item per row
+//  for short rows, or a group of work items per row, sized to the mean row length, for long rows.
+//  The kernels are variants of one templated source (see CLSimpleWrapper::selectKernelVariant()).
+class CLSparse
+{
+public:
+    // compressed sparse row: the nonzeros of row r are [row_offsets[r], row_offsets[r + 1]) of col_indices and values,
+    //  in any column order.
+    template<typename T>
+    struct Csr
+    {
+        size_t rows = 0;
+        size_t cols = 0;
+        std::vector<cl_uint> row_offsets;   // rows + 1
+        std::vector<cl_uint> col_indices;
+        std::vector<T> values;
+    };
+
+    // sliced ELL: slices of slice_height rows, each one padded to its longest row and stored column major, entry j of
+    //  row r is at slice_offsets[r / slice_height] + j * slice_height + r % slice_height. The work items of a slice
+    //  read consecutive addresses, and padding (value 0) is only paid up to the longest row of each slice.
+    //  ELL is the single slice case.
+    template<typename T>
+    struct Ell
+    {
+        size_t rows = 0;
+        size_t cols = 0;
+        size_t slice_height = 0;
+        std::vector<cl_uint> slice_offsets;     // slices + 1, in entries
+        std::vector<cl_uint> col_indices;
+        std::vector<T> values;
+    };
+
+    struct RowStats
+    {
+        size_t min_length;
+        size_t max_length;
+        double mean_length;
+        double stddev;
+    };
+
+    enum class SpmvKernel
+    {
+        Auto,       // chosen with selectSpmvKernel()
+        ScalarRow,  // one work item per row: no idle work item on short rows, a long row stalls its neighbors
+        VectorRow   // getVectorWidth() work items per row, reading the row together and reduced in __local memory
+    };
+
+    explicit CLSparse(std::shared_ptr<CLSession> session);
+
+    // y (rows) = A * x (cols).
+    void spmv(const Csr<float>& a, const float* x, float* y, SpmvKernel kernel = SpmvKernel::Auto);
+
+    void spmv(const Csr<double>& a, const double* x, double* y, SpmvKernel kernel = SpmvKernel::Auto);
+
+    void spmv(const Ell<float>& a, const float* x, float* y);
+
+    void spmv(const Ell<double>& a, const double* x, double* y);
+
+    // C (rows x N) = A * B (cols x N), B and C dense row major.
+    void spmm(const Csr<float>& a, const float* b, float* c, size_t N);
+
+    void spmm(const Csr<double>& a, const double* b, double* c, size_t N);
+
+    // record the transfer and kernel timings, see CLSimpleWrapper::getProfilingStats().
+    //  the session queue must be created with CL_QUEUE_PROFILING_ENABLE.
+    void enableProfiling(bool enable = true);
+
+    CLSimpleWrapper& getWrapper();
+
+    static RowStats getRowStats(const std::vector<cl_uint>& row_offsets);
+
+    // ScalarRow when the rows are short and even, VectorRow otherwise.
+    static SpmvKernel selectSpmvKernel(const RowStats& stats);
+
+    // work items per row of VectorRow: the mean row length rounded up to a power of two, within [2, 32].
+    static size_t getVectorWidth(const RowStats& stats);
+
+    // nonzeros of a row major dense matrix.
+    template<typename T>
+    static Csr<T> fromDense(const T* dense, size_t rows, size_t cols)
+    {
+        Csr<T> csr;
+        csr.rows = rows;
+        csr.cols = cols;
+        csr.row_offsets.reserve(rows + 1);
+        csr.row_offsets.push_back(0);
+        for ( size_t row = 0; row < rows; row++ )
+        {
+            for ( size_t col = 0; col < cols; col++ )
+            {
+                if ( dense[row * cols + col] != (T)0 )
+                {
+                    csr.col_indices.push_back((cl_uint)col);
+                    csr.values.push_back(dense[row * cols + col]);
+                }
+            }
+            csr.row_offsets.push_back((cl_uint)csr.values.size());
+        }
+        return csr;
+    }
+
+    // (row, col, value) triplets in any order, counting sort by row. Duplicates are kept, they add up in the products.
+    template<typename T>
+    static Csr<T> fromCoo(size_t rows, size_t cols, const std::vector<cl_uint>& row_indices,
+        const std::vector<cl_uint>& col_indices, const std::vector<T>& values)
+    {
+        Csr<T> csr;
+        csr.rows = rows;
+        csr.cols = cols;
+        csr.row_offsets.assign(rows + 1, 0);
+        for ( cl_uint row : row_indices )
+        {
+            csr.row_offsets[row + 1]++;
+        }
+        for ( size_t row = 0; row < rows; row++ )
+        {
+            csr.row_offsets[row + 1] += csr.row_offsets[row];
+        }
+
+        std::vector<cl_uint> next(csr.row_offsets.begin(), csr.row_offsets.end() - 1);
+        csr.col_indices.resize(values.size());
+        csr.values.resize(values.size());
+        for ( size_t i = 0; i < values.size(); i++ )
+        {
+            cl_uint position = next[row_indices[i]]++;
+            csr.col_indices[position] = col_indices[i];
+            csr.values[position] = values[i];
+        }
+        return csr;
+    }
+
+    // slice_height 0: ELL, a single slice padded to the longest row of the matrix.
+    template<typename T>
+    static Ell<T> toEll(const Csr<T>& csr, size_t slice_height = 0)
+    {
+        Ell<T> ell;
+        ell.rows = csr.rows;
+        ell.cols = csr.cols;
+        ell.slice_height = (0 == slice_height) ? std::max<size_t>(1, csr.rows) : slice_height;
+
+        size_t slices = (csr.rows + ell.slice_height - 1) / ell.slice_height;
+        ell.slice_offsets.push_back(0);
+        for ( size_t slice = 0; slice < slices; slice++ )
+        {
+            size_t first = slice * ell.slice_height;
+            size_t width = 0;
+            for ( size_t row = first; row < std::min(csr.rows, first + ell.slice_height); row++ )
+            {
+                width = std::max<size_t>(width, csr.row_offsets[row + 1] - csr.row_offsets[row]);
+            }
+
+            // the last slice is padded to slice_height rows too, so that every slice has the same layout
+            size_t begin = ell.values.size();
+            ell.col_indices.resize(begin + width * ell.slice_height, 0);
+            ell.values.resize(begin + width * ell.slice_height, (T)0);
+            for ( size_t row = first; row < std::min(csr.rows, first + ell.slice_height); row++ )
+            {
+                for ( cl_uint i = csr.row_offsets[row]; i < csr.row_offsets[row + 1]; i++ )
+                {
+                    size_t position = begin + (i - csr.row_offsets[row]) * ell.slice_height + (row - first);
+                    ell.col_indices[position] = csr.col_indices[i];
+                    ell.values[position] = csr.values[i];
+                }
+            }
+            ell.slice_offsets.push_back((cl_uint)ell.values.size());
+        }
+        return ell;
+    }
+
+    template<typename T>
+    static void toDense(const Csr<T>& csr, T* dense)
+    {
+        std::fill(dense, dense + csr.rows * csr.cols, (T)0);
+        for ( size_t row = 0; row < csr.rows; row++ )
+        {
+            for ( cl_uint i = csr.row_offsets[row]; i < csr.row_offsets[row + 1]; i++ )
+            {
+                dense[row * csr.cols + csr.col_indices[i]] += csr.values[i];
+            }
+        }
+    }
+
+    // device memory of the matrix, in bytes.
+    template<typename T>
+    static size_t getFootprint(const Csr<T>& csr)
+    {
+        return (csr.row_offsets.size() + csr.col_indices.size()) * sizeof(cl_uint) + csr.values.size() * sizeof(T);
+    }
+
+    template<typename T>
+    static size_t getFootprint(const Ell<T>& ell)
+    {
+        return (ell.slice_offsets.size() + ell.col_indices.size()) * sizeof(cl_uint) + ell.values.size() * sizeof(T);
+    }
+
+    // host reference implementations, used to check the result of spmv() and spmm().
+    template<typename T>
+    static void spmvReference(const Csr<T>& a, const T* x, T* y)
+    {
+        for ( size_t row = 0; row < a.rows; row++ )
+        {
+            T sum = 0;
+            for ( cl_uint i = a.row_offsets[row]; i < a.row_offsets[row + 1]; i++ )
+            {
+                sum += a.values[i] * x[a.col_indices[i]];
+            }
+            y[row] = sum;
+        }
+    }
+
+    template<typename T>
+    static void spmmReference(const Csr<T>& a, const T* b, T* c, size_t N)
+    {
+        std::fill(c, c + a.rows * N, (T)0);
+        for ( size_t row = 0; row < a.rows; row++ )
+        {
+            for ( cl_uint i = a.row_offsets[row]; i < a.row_offsets[row + 1]; i++ )
+            {
+                for ( size_t col = 0; col < N; col++ )
+                {
+                    c[row * N + col] += a.values[i] * b[a.col_indices[i] * N + col];
+                }
+            }
+        }
+    }
+
+private:
+    // select the kernel of the element type ("float" or "double") and vector width, built on first use.
+    void selectKernel(const std::string& type_name, const std::string& kernel_name, size_t vector_width = 1);
+
+    template<typename T>
+    void runSpmv(const Csr<T>& a, const T* x, T* y, SpmvKernel kernel, const std::string& type_name);
+
+    template<typename T>
+    void runSpmvEll(const Ell<T>& a, const T* x, T* y, const std::string& type_name);
+
+    template<typename T>
+    void runSpmm(const Csr<T>& a, const T* b, T* c, size_t N, const std::string& type_name);
+
+    std::string m_source;   // selectKernelVariant() takes the source by reference
+
+    CLSimpleWrapper m_wrapper;
+};
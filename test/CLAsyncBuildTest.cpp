@@ -0,0 +1,36 @@
+#include <iostream>
+#include <string>
+
+#include "CLSimpleWrapper.h"
+
+// createCLKernelAsync() whose build fails at once (no session): the error is returned by the handle only, the
+//  next createCLKernel() / selectKernel() report their own result instead of the pending kernel.
+
+std::string ClSrcFill = R"CLC(
+__kernel void fill(__global int* out)
+{
+    size_t i = get_global_id(0);
+    out[i] = (int)i;
+}
+)CLC";
+
+bool check(const std::string& name, cl_int error, cl_int expected)
+{
+    bool is_passed = (error == expected);
+    std::cout << name << ": " << (is_passed ? "PASS" : "FAIL") << "\n";
+    return is_passed;
+}
+
+int main()
+{
+    CLSimpleWrapper cl_wrapper;     // initOpenCL() not called
+
+    CLBuildHandle handle = cl_wrapper.createCLKernelAsync(ClSrcFill, "fill");
+    bool is_passed = check("async build without session", handle.wait(), CL_INVALID_CONTEXT);
+    is_passed = check("build after the failed async build", cl_wrapper.createCLKernel(ClSrcFill, "fill"),
+        CL_INVALID_CONTEXT) && is_passed;
+    is_passed = check("select after the failed async build", cl_wrapper.selectKernel("fill"),
+        CL_INVALID_KERNEL_NAME) && is_passed;
+
+    return is_passed ? 0 : 1;
+}
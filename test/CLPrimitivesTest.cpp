@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "CLPrimitives.h"
+
+// CLPrimitives against the host results at small and odd sizes: a single element, one block (work group size x
+//  items per work item) plus and minus one, and sizes that need two and three levels of block results.
+//  Skipped when there is no device.
+
+#define BLOCK (256 * 8)     // PRIM_WG * PRIM_ITEMS of CLPrimitives.cpp
+
+bool check(const std::string& name, size_t count, bool is_passed)
+{
+    if ( !is_passed )
+    {
+        std::cout << name << " " << count << ": FAIL\n";
+    }
+    return is_passed;
+}
+
+bool testSize(CLPrimitives& primitives, size_t count)
+{
+    std::vector<int> values(count);
+    for ( int& value : values )
+    {
+        value = rand() % 201 - 100;
+    }
+
+    bool is_passed = true;
+    int sum = 0;
+    for ( int value : values )
+    {
+        sum += value;
+    }
+    is_passed = check("reduce sum", count, primitives.reduce(values.data(), count) == sum) && is_passed;
+    is_passed = check("reduce min", count, primitives.reduce(values.data(), count, CLPrimitives::ReduceOp::Min) ==
+        *std::min_element(values.begin(), values.end())) && is_passed;
+    is_passed = check("reduce max", count, primitives.reduce(values.data(), count, CLPrimitives::ReduceOp::Max) ==
+        *std::max_element(values.begin(), values.end())) && is_passed;
+
+    for ( bool is_exclusive : { false, true } )
+    {
+        std::vector<int> expected(count);
+        int running = 0;
+        for ( size_t i = 0; i < count; i++ )
+        {
+            expected[i] = is_exclusive ? running : running + values[i];
+            running += values[i];
+        }
+        std::vector<int> output(count);
+        primitives.scan(values.data(), output.data(), count, is_exclusive);
+        is_passed = check(is_exclusive ? "scan exclusive" : "scan inclusive", count, output == expected) && is_passed;
+    }
+
+    // no flag, every flag, and one element out of three
+    for ( int pattern = 0; pattern < 3; pattern++ )
+    {
+        std::vector<unsigned int> flags(count);
+        std::vector<int> expected;
+        for ( size_t i = 0; i < count; i++ )
+        {
+            flags[i] = (1 == pattern || (2 == pattern && 0 == i % 3)) ? 1 : 0;
+            if ( flags[i] )
+            {
+                expected.push_back(values[i]);
+            }
+        }
+        std::vector<int> output(count, 0);
+        size_t selected = primitives.compact(values.data(), flags.data(), output.data(), count);
+        output.resize(std::min(selected, count));
+        is_passed = check(0 == pattern ? "compact none" : 1 == pattern ? "compact all" : "compact every third",
+            count, selected == expected.size() && output == expected) && is_passed;
+    }
+
+    std::vector<int> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<int> keys = values;
+    primitives.sort(keys.data(), count);
+    is_passed = check("sort", count, keys == sorted) && is_passed;
+
+    std::cout << count << ": " << (is_passed ? "PASS" : "FAIL") << "\n";
+    return is_passed;
+}
+
+int main()
+{
+    std::shared_ptr<CLSession> session = CLSession::create(-1, -1);
+    if ( !session->isValid() )
+    {
+        std::cout << "primitives: skipped, no device\n";
+        return 0;
+    }
+
+    CLPrimitives primitives(session);
+    bool is_passed = true;
+    for ( size_t count : { (size_t)1, (size_t)2, (size_t)BLOCK - 1, (size_t)BLOCK, (size_t)BLOCK + 1,
+        (size_t)BLOCK * BLOCK - 1, (size_t)BLOCK * BLOCK + 1 } )
+    {
+        is_passed = testSize(primitives, count) && is_passed;
+    }
+    return is_passed ? 0 : 1;
+}
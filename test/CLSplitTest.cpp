@@ -0,0 +1,79 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "CLSimpleWrapper.h"
+
+// executeKernelSplit() / readBufferSplit() when the first device gets no work: every other device must read back
+//  its own slice, after its own kernel. The ranges are checked on the host, the gathered result on the first
+//  platform with two devices or more (skipped when there is none).
+
+#define ELEMENT_COUNT 4096
+#define WORK_GROUP 64
+
+std::string ClSrcFill = R"CLC(
+__kernel void fill(__global int* out)
+{
+    size_t i = get_global_id(0);
+    out[i] = (int)i * 3 + 1;
+}
+)CLC";
+
+typedef std::vector<std::pair<size_t, size_t> > SplitRanges;
+
+bool checkRanges(const std::string& name, const SplitRanges& ranges, const SplitRanges& expected)
+{
+    bool is_passed = (ranges == expected);
+    std::cout << name << ": " << (is_passed ? "PASS" : "FAIL") << "\n";
+    return is_passed;
+}
+
+int main()
+{
+    bool is_passed = checkRanges("first device without work",
+        CLSimpleWrapper::getSplitRanges({ 0.0, 1.0 }, ELEMENT_COUNT, WORK_GROUP),
+        { { 0, 0 }, { 0, ELEMENT_COUNT } });
+    is_passed = checkRanges("first device without work, three devices",
+        CLSimpleWrapper::getSplitRanges({ 0.0, 0.5, 0.5 }, ELEMENT_COUNT, WORK_GROUP),
+        { { 0, 0 }, { 0, ELEMENT_COUNT / 2 }, { ELEMENT_COUNT / 2, ELEMENT_COUNT / 2 } }) && is_passed;
+
+    std::vector<cl_platform_id> platforms = CLSession::getPlatformIds();
+    int platform_index = -1;
+    for ( size_t i = 0; i < platforms.size() && platform_index < 0; i++ )
+    {
+        if ( CLSession::getDeviceIds(platforms[i]).size() >= 2 )
+        {
+            platform_index = (int)i;
+        }
+    }
+    if ( platform_index < 0 )
+    {
+        std::cout << "split read back: skipped, no platform with two devices\n";
+        return is_passed ? 0 : 1;
+    }
+
+    CLSimpleWrapper cl_wrapper;
+    cl_wrapper.initOpenCLMultiDevice(platform_index);
+    std::vector<double> ratios(cl_wrapper.getDeviceCount(), 1.0);
+    ratios[0] = 0.0;
+    cl_wrapper.setSplitRatios(ratios);
+
+    cl_int error = cl_wrapper.createCLKernel(ClSrcFill, "fill");
+    CLSimpleWrapper::checkCLError(error, "Build Program Failed");
+    cl_wrapper.setKernelSplitBufferArg(0, ELEMENT_COUNT * sizeof(int));
+
+    std::vector<int> output(ELEMENT_COUNT, -1);
+    size_t global_item_size = ELEMENT_COUNT;
+    size_t local_item_size = WORK_GROUP;
+    cl_wrapper.executeKernelSplit(1, &global_item_size, &local_item_size, 0);
+    cl_wrapper.readBufferSplit(output.data(), 0, sizeof(int));
+
+    bool is_correct = true;
+    for ( size_t i = 0; i < ELEMENT_COUNT; i++ )
+    {
+        is_correct = is_correct && (output[i] == (int)i * 3 + 1);
+    }
+    std::cout << "split read back: " << (is_correct ? "PASS" : "FAIL") << "\n";
+
+    return (is_passed && is_correct) ? 0 : 1;
+}